@@ -0,0 +1,589 @@
+#include <iostream>
+#include <exception>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <cstdlib>
+#include <cstring>
+
+#include "utilities.hpp"
+#include "genetic.hpp"
+#include "localsearch.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+#define MICROBENCH_REPETITIONS 7		// Measures of each kernel, the median one is reported
+#define MICROBENCH_MIN_TIME 100			// ms, duration of each measure
+#define MICROBENCH_SEED 12345			// The samples are the same at every run
+#define MICROBENCH_WARMUP_GENERATIONS 200		// Generations evolved before taking the samples
+
+using namespace std;
+
+
+/* ============ ALLOCATION COUNTING ============ */
+
+
+// Every allocation of the process goes through the replaced global operator new (the array forms call it too)
+static atomic<unsigned long long> allocations(0);
+static atomic<unsigned long long> allocatedBytes(0);
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, memory_order_relaxed);
+	allocatedBytes.fetch_add(size, memory_order_relaxed);
+
+	void* block = malloc(size > 0 ? size : 1);
+	if (block == nullptr)
+		throw bad_alloc();
+	return block;
+}
+
+void operator delete(void* block) noexcept
+{
+	free(block);
+}
+
+void operator delete(void* block, size_t) noexcept
+{
+	free(block);
+}
+
+
+/* ============ HARDWARE COUNTERS ============ */
+
+
+/*
+** HardwareCounters reads the performance counters of the CPU for the calling thread, through perf_event on Linux.
+** The counters are opened as a group, so they are enabled and disabled together; those the CPU (or the permissions
+** set in /proc/sys/kernel/perf_event_paranoid) do not allow are reported as unavailable, as are all of them elsewhere
+*/
+class HardwareCounters
+{
+
+public:
+
+	enum Counter { CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES, N_COUNTERS };
+
+private:
+
+	int descriptors[N_COUNTERS];
+	int positions[N_COUNTERS];		// Of each counter in the values read from the group, -1 if unavailable
+	int opened;
+
+
+public:
+
+	HardwareCounters()
+		: opened(0)
+	{
+		for (int c = 0; c < N_COUNTERS; c++)
+			descriptors[c] = -1, positions[c] = -1;
+
+#ifdef __linux__
+		const uint64_t configs[N_COUNTERS] = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+
+		for (int c = 0; c < N_COUNTERS; c++)
+		{
+			perf_event_attr attributes;
+			memset(&attributes, 0, sizeof(attributes));
+			attributes.size = sizeof(attributes);
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.config = configs[c];
+			attributes.disabled = (opened == 0) ? 1 : 0;		// The group follows its leader
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			attributes.read_format = PERF_FORMAT_GROUP;
+
+			descriptors[c] = (int)syscall(SYS_perf_event_open, &attributes, 0, -1, opened == 0 ? -1 : getLeader(), 0);
+			if (descriptors[c] >= 0)
+				positions[c] = opened++;
+		}
+#endif
+	}
+
+	~HardwareCounters()
+	{
+#ifdef __linux__
+		for (int c = 0; c < N_COUNTERS; c++)
+		{
+			if (descriptors[c] >= 0)
+				close(descriptors[c]);
+		}
+#endif
+	}
+
+	bool isAvailable(Counter counter) const { return positions[counter] >= 0; }
+
+	void reset()
+	{
+#ifdef __linux__
+		if (opened > 0)
+			ioctl(getLeader(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	void enable()
+	{
+#ifdef __linux__
+		if (opened > 0)
+			ioctl(getLeader(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	void disable()
+	{
+#ifdef __linux__
+		if (opened > 0)
+			ioctl(getLeader(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	void read(uint64_t values[N_COUNTERS]) const
+	{
+		uint64_t group[N_COUNTERS + 1] = { 0 };		// Number of counters, then their values
+#ifdef __linux__
+		if (opened > 0 && ::read(getLeader(), group, sizeof(group)) <= 0)
+			memset(group, 0, sizeof(group));
+#endif
+		for (int c = 0; c < N_COUNTERS; c++)
+			values[c] = (positions[c] >= 0) ? group[1 + positions[c]] : 0;
+	}
+
+private:
+
+	int getLeader() const
+	{
+		for (int c = 0; c < N_COUNTERS; c++)
+		{
+			if (positions[c] == 0)
+				return descriptors[c];
+		}
+		return -1;
+	}
+
+};
+
+
+/*
+** Stopwatch measures the timed sections of a kernel run: time, allocations and hardware counters
+** are accumulated only between resume() and pause(), leaving out the preparation of each operation
+*/
+class Stopwatch
+{
+
+private:
+
+	HardwareCounters& counters;
+	chrono::steady_clock::time_point started;
+	unsigned long long allocationsAtResume;
+	unsigned long long bytesAtResume;
+
+public:
+
+	double elapsed_ns;
+	unsigned long long allocations;
+	unsigned long long bytes;
+
+
+	Stopwatch(HardwareCounters& counters)
+		: counters(counters), allocationsAtResume(0), bytesAtResume(0),
+		elapsed_ns(0), allocations(0), bytes(0)
+	{ };
+
+	void reset()
+	{
+		elapsed_ns = 0, allocations = 0, bytes = 0;
+		counters.reset();
+	}
+
+	void resume()
+	{
+		allocationsAtResume = ::allocations.load(memory_order_relaxed);
+		bytesAtResume = allocatedBytes.load(memory_order_relaxed);
+		counters.enable();
+		started = chrono::steady_clock::now();
+	}
+
+	void pause()
+	{
+		chrono::steady_clock::time_point stopped = chrono::steady_clock::now();
+		counters.disable();
+		elapsed_ns += chrono::duration<double, nano>(stopped - started).count();
+		allocations += ::allocations.load(memory_order_relaxed) - allocationsAtResume;
+		bytes += allocatedBytes.load(memory_order_relaxed) - bytesAtResume;
+	}
+
+};
+
+
+/* ============ KERNELS ============ */
+
+
+/*
+** MicroBenchmark times the hot kernels of the solver one by one, on the real instance given on the command line.
+** The operators of the genetic algorithm run on an island evolved for a few generations from a fixed seed,
+** so the samples (and the measures) are the same at every run of the same build
+*/
+class MicroBenchmark
+{
+
+	// Measures of a kernel, each field per operation
+	struct Measure {
+		unsigned long long ops;
+		double ns;
+		double allocations;
+		double bytes;
+		double counters[HardwareCounters::N_COUNTERS];
+	};
+
+	struct Kernel {
+		const char* name;
+		void (MicroBenchmark::*run)(Stopwatch& watch, unsigned long long ops);
+	};
+
+private:
+
+	const string fileName;
+	const Parameters& parameters;
+	Instance problemInstance;
+	unique_ptr<Genetic> genetic;
+	unique_ptr<Genetic::GeneticThread> island;
+	unique_ptr<LocalSearch> refiner;
+	vector<Solution> samples;		// Individuals of the evolved population
+	vector<Solution> scratch;		// Copies of the samples, modified by the operators
+	HardwareCounters counters;
+
+
+public:
+
+	MicroBenchmark(const string& fileName, const Parameters& parameters)
+		: fileName(fileName), parameters(parameters)
+	{ };
+
+	void setUp()
+	{
+		problemInstance.readInputFile(fileName);
+		if (parameters.presolve)
+			problemInstance.presolve();
+
+		genetic.reset(new Genetic(problemInstance));
+		genetic->parameters = &parameters;
+		island.reset(new Genetic::GeneticThread(*genetic, 1));
+		refiner.reset(new LocalSearch(problemInstance));
+
+		// Evolve the population for a while, the samples should look like the individuals of a real search
+		island->random_number.seed(MICROBENCH_SEED);
+		island->initializePopulation(0);
+		for (int g = 0; g < MICROBENCH_WARMUP_GENERATIONS; g++)
+		{
+			island->breedPopulation();
+			island->replacePopulationByFitness();
+		}
+
+		island->selectSurvivors();
+		for (int i = 0; i < island->populationSize; i++)
+			samples.push_back(*island->population[i].individual);
+		scratch = samples;
+	}
+
+	void run(const string& filter, int repetitions, unsigned int minTime_ms, FILE* csv)
+	{
+		const Kernel kernels[] = {
+			{ "Instance::readInputFile", &MicroBenchmark::readInputFile },
+			{ "Solution::evaluate", &MicroBenchmark::evaluate },
+			{ "Solution::evaluateMemory", &MicroBenchmark::evaluateMemory },
+			{ "randomBelow", &MicroBenchmark::randomBelow },
+			{ "GeneticThread::crossover", &MicroBenchmark::crossover },
+			{ "GeneticThread::mutate", &MicroBenchmark::mutate },
+			{ "breedPopulation", &MicroBenchmark::breedPopulation },
+			{ "replacePopulationByFitness", &MicroBenchmark::replacePopulationByFitness },
+			{ "LocalSearch::run", &MicroBenchmark::localSearch },
+		};
+
+		fprintf_s(stdout, "%-28s %10s %12s %12s %10s %10s %10s %10s %6s %10s %10s\n", "Kernel", "Ops", "ns/op", "min ns/op",
+			"allocs/op", "bytes/op", "cycles/op", "instrs/op", "IPC", "cmiss/op", "bmiss/op");
+		if (csv != nullptr)
+			fprintf_s(csv, "kernel,ops,ns_per_op,min_ns_per_op,allocations_per_op,bytes_per_op,"
+				"cycles_per_op,instructions_per_op,cache_misses_per_op,branch_misses_per_op\n");
+
+		for (const Kernel& kernel : kernels)
+		{
+			if (!filter.empty() && string(kernel.name).find(filter) == string::npos)
+				continue;
+
+			vector<Measure> measures;
+			unsigned long long ops = calibrate(kernel, minTime_ms);
+			for (int r = 0; r < repetitions; r++)
+				measures.push_back(measure(kernel, ops));
+
+			std::sort(measures.begin(), measures.end(), [](const Measure& a, const Measure& b) { return a.ns < b.ns; });
+			report(kernel.name, measures[measures.size() / 2], measures.front().ns, csv);
+		}
+
+		if (!counters.isAvailable(HardwareCounters::CYCLES))
+			fprintf_s(stdout, "Hardware counters unavailable (perf_event on Linux only, check /proc/sys/kernel/perf_event_paranoid)\n");
+	}
+
+private:
+
+	// Operations giving a measure of about minTime_ms, grown from a single one
+	unsigned long long calibrate(const Kernel& kernel, unsigned int minTime_ms)
+	{
+		unsigned long long ops = 1;
+		for (;;)
+		{
+			Measure trial = measure(kernel, ops);
+			double total_ms = trial.ns * ops / 1e6;
+			if (total_ms >= minTime_ms / 10.0)
+				return std::max(ops, (unsigned long long)(ops * minTime_ms / std::max(total_ms, 1e-3)));
+			ops *= 10;
+		}
+	}
+
+	Measure measure(const Kernel& kernel, unsigned long long ops)
+	{
+		Stopwatch watch(counters);
+		watch.reset();
+		(this->*kernel.run)(watch, ops);
+
+		uint64_t values[HardwareCounters::N_COUNTERS];
+		counters.read(values);
+
+		Measure result = { ops, watch.elapsed_ns / ops, (double)watch.allocations / ops, (double)watch.bytes / ops };
+		for (int c = 0; c < HardwareCounters::N_COUNTERS; c++)
+			result.counters[c] = (double)values[c] / ops;
+		return result;
+	}
+
+	void report(const char* name, const Measure& median, double min_ns, FILE* csv) const
+	{
+		char values[HardwareCounters::N_COUNTERS][32];
+		for (int c = 0; c < HardwareCounters::N_COUNTERS; c++)
+		{
+			if (counters.isAvailable((HardwareCounters::Counter)c))
+				sprintf_s(values[c], sizeof(values[c]), "%.1f", median.counters[c]);
+			else
+				strcpy_s(values[c], sizeof(values[c]), "-");
+		}
+
+		char ipc[32] = "-";
+		if (counters.isAvailable(HardwareCounters::CYCLES) && counters.isAvailable(HardwareCounters::INSTRUCTIONS) &&
+			median.counters[HardwareCounters::CYCLES] > 0)
+			sprintf_s(ipc, sizeof(ipc), "%.2f", median.counters[HardwareCounters::INSTRUCTIONS] / median.counters[HardwareCounters::CYCLES]);
+
+		fprintf_s(stdout, "%-28s %10llu %12.1f %12.1f %10.2f %10.1f %10s %10s %6s %10s %10s\n", name, median.ops, median.ns, min_ns,
+			median.allocations, median.bytes, values[HardwareCounters::CYCLES], values[HardwareCounters::INSTRUCTIONS], ipc,
+			values[HardwareCounters::CACHE_MISSES], values[HardwareCounters::BRANCH_MISSES]);
+
+		// Unavailable counters are left empty
+		if (csv != nullptr)
+		{
+			fprintf_s(csv, "%s,%llu,%.1f,%.1f,%.2f,%.1f", name, median.ops, median.ns, min_ns, median.allocations, median.bytes);
+			for (int c = 0; c < HardwareCounters::N_COUNTERS; c++)
+				fprintf_s(csv, ",%s", counters.isAvailable((HardwareCounters::Counter)c) ? values[c] : "");
+			fprintf_s(csv, "\n");
+		}
+	}
+
+
+	void readInputFile(Stopwatch& watch, unsigned long long ops)
+	{
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+		{
+			Instance copy;
+			copy.readInputFile(fileName);
+		}
+		watch.pause();
+	}
+
+	void evaluate(Stopwatch& watch, unsigned long long ops)
+	{
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+			samples[i % samples.size()].evaluate();
+		watch.pause();
+	}
+
+	void evaluateMemory(Stopwatch& watch, unsigned long long ops)
+	{
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+			samples[i % samples.size()].evaluateMemory();
+		watch.pause();
+	}
+
+	// A draw of a gene, the bounded sampling the operators use most
+	void randomBelow(Stopwatch& watch, unsigned long long ops)
+	{
+		RandomEngine engine(MICROBENCH_SEED);
+		uint32_t range = (uint32_t)std::max(problemInstance.nQueries, 1);
+		uint32_t sum = 0;
+
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+			sum += ::randomBelow(engine, range);
+		watch.pause();
+
+		// Keep the draws from being optimized away
+		volatile uint32_t sink = sum;
+		(void)sink;
+	}
+
+	void crossover(Stopwatch& watch, unsigned long long ops)
+	{
+		size_t pairs = scratch.size() / 2;
+
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+			island->crossover(&scratch[2 * (i % pairs)], &scratch[2 * (i % pairs) + 1], MIN_CROSSOVER_POINTS + (int)(i % 4));
+		watch.pause();
+	}
+
+	void mutate(Stopwatch& watch, unsigned long long ops)
+	{
+		watch.resume();
+		for (unsigned long long i = 0; i < ops; i++)
+			island->mutate(&scratch[i % scratch.size()]);
+		watch.pause();
+	}
+
+	// A generation is breeding then replacement, each kernel is timed while the other one keeps the population going
+	void breedPopulation(Stopwatch& watch, unsigned long long ops)
+	{
+		for (unsigned long long i = 0; i < ops; i++)
+		{
+			watch.resume();
+			island->breedPopulation();
+			watch.pause();
+			island->replacePopulationByFitness();
+		}
+	}
+
+	void replacePopulationByFitness(Stopwatch& watch, unsigned long long ops)
+	{
+		for (unsigned long long i = 0; i < ops; i++)
+		{
+			island->breedPopulation();
+			watch.resume();
+			island->replacePopulationByFitness();
+			watch.pause();
+		}
+	}
+
+	void localSearch(Stopwatch& watch, unsigned long long ops)
+	{
+		for (unsigned long long i = 0; i < ops; i++)
+		{
+			refiner->setStartingPoint(samples[i % samples.size()]);
+			watch.resume();
+			refiner->run(parameters);
+			watch.pause();
+		}
+	}
+
+};
+
+
+/* ============ MAIN ============ */
+
+
+#define COMMAND_LINE_FORMAT "\n$ODBDPmicrobench.exe <instancefilename> [-r <repetitions>] [--min-time <ms>] [--filter <kernel>]\
+ [--kernel auto|scalar|avx2|avx512] [--no-presolve] [--csv <filename>]"
+
+
+int main(int argc, char **argv)
+{
+	Parameters parameters;
+	string fileName, filter, csvFileName;
+	int repetitions = MICROBENCH_REPETITIONS;
+	unsigned int minTime_ms = MICROBENCH_MIN_TIME;
+
+	try
+	{
+		// Command line parameters parsing
+		for (int i = 1; i < argc; i++)
+		{
+			if (strcmp(argv[i], "-r") == 0 && i < argc - 1)
+			{
+				if (atoi(argv[i + 1]) <= 0)
+					throw exception("The number of repetitions must be a positive integer");
+				repetitions = atoi(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--min-time") == 0 && i < argc - 1)
+			{
+				if (atoi(argv[i + 1]) <= 0)
+					throw exception("The duration of the measures must be a positive number of milliseconds");
+				minTime_ms = (unsigned) atoi(argv[++i]);
+			}
+			else if (strcmp(argv[i], "--filter") == 0 && i < argc - 1)
+				filter = argv[++i];
+			else if (strcmp(argv[i], "--kernel") == 0 && i < argc - 1)
+			{
+				i++;
+				if (strcmp(argv[i], "auto") == 0)
+					parameters.kernels = KERNEL_AUTO;
+				else if (strcmp(argv[i], "scalar") == 0)
+					parameters.kernels = KERNEL_SCALAR;
+				else if (strcmp(argv[i], "avx2") == 0)
+					parameters.kernels = KERNEL_AVX2;
+				else if (strcmp(argv[i], "avx512") == 0)
+					parameters.kernels = KERNEL_AVX512;
+				else
+					throw exception("The kernels must be one of 'auto', 'scalar', 'avx2' or 'avx512'");
+			}
+			else if (strcmp(argv[i], "--no-presolve") == 0)
+				parameters.presolve = false;
+			else if (strcmp(argv[i], "--csv") == 0 && i < argc - 1)
+				csvFileName = argv[++i];
+			else if (fileName.length() == 0)
+				fileName = argv[i];
+			else
+				throw exception("Command line parsing error, expected:" COMMAND_LINE_FORMAT);
+		}
+		if (fileName.length() == 0)
+			throw exception("Missing instance file name, expected:" COMMAND_LINE_FORMAT);
+
+		parameters.inputFileName = fileName;
+		parameters.nThreads = 1;
+		parameters.verbose = false;
+		parameters.kernels = selectKernels(parameters.kernels);
+		fprintf_s(stdout, "Using %s evaluation kernels, %d measures of %u ms for each kernel\n",
+			getKernelName(parameters.kernels), repetitions, minTime_ms);
+
+		MicroBenchmark benchmark(fileName, parameters);
+		benchmark.setUp();
+
+		FILE* csv = nullptr;
+		if (csvFileName.length() > 0)
+		{
+			fopen_s(&csv, csvFileName.c_str(), "w");
+			if (csv == nullptr)
+				throw exception(("Error: unable to write the measures on file '" + csvFileName + "'").c_str());
+		}
+
+		benchmark.run(filter, repetitions, minTime_ms, csv);
+
+		if (csv != nullptr)
+		{
+			fclose(csv);
+			fprintf_s(stdout, "Measures written on file '%s'\n", csvFileName.c_str());
+		}
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	return 0;
+}
@@ -0,0 +1,12 @@
+#include "algorithm.hpp"
+#include "genetic.hpp"
+#include "branchbound.hpp"
+
+
+Algorithm* createAlgorithm(AlgorithmType type, Instance& inst)
+{
+	if (type == ALGORITHM_BRANCH_AND_BOUND)
+		return new BranchBound(inst);
+
+	return new Genetic(inst);
+}
@@ -1,6 +1,22 @@
 #pragma once
 
+#include <vector>
+#include <mutex>
+#include <algorithm>
+
 #include "utilities.hpp"
+#include "upperbound.hpp"
+#include "stoptoken.hpp"
+
+
+// Progress of a search, collected for the benchmarks
+struct SearchStatistics {
+	vector<pair<double, long>> improvements;	// Time from the start of the search (s) and objective value of each new best solution
+	unsigned long long generations = 0;			// Generations of the islands (for the branch and bound, of its warm start)
+	unsigned long long evaluations = 0;			// Solutions actually scored: full evaluations missing the caches and offsprings
+												// rescored incrementally (for the branch and bound, also the nodes bounded)
+	double time_s = 0;							// Duration of the search
+};
 
 
 /*
@@ -15,16 +31,73 @@ protected:
 
 	Instance& problemInstance;
 	Solution bestSolution;
+	const UpperBound* upperBound;		// Bound on the optimal objective value, nullptr if not computed
+	StopToken stopToken;				// Raised to stop the threads of the search, armed with the time limit by run()
+	SearchStatistics statistics;		// Filled by run()
+	long searchBound;					// Bound on the optimal objective value proven by the search, LONG_MAX if none
+
+private:
+
+	long long statisticsStartTime;
+	mutex statisticsMutex;
 
 public:
 
 	Algorithm(Instance& inst)
 		: problemInstance(inst),
-		bestSolution(Solution(inst))
+		bestSolution(Solution(inst)),
+		upperBound(nullptr),
+		searchBound(LONG_MAX),
+		statisticsStartTime(0)
 	{ };
 
+	virtual ~Algorithm() { };
+
 	virtual Solution run(const Parameters& parameters) = 0;
 
-private:
+	void setUpperBound(const UpperBound* bound) { upperBound = bound; }
+	StopToken::Reason getStopReason() const { return stopToken.getReason(); }		// NONE if the search completed
+	const SearchStatistics& getStatistics() const { return statistics; }
+
+	// Bound on the optimal objective value after run(): the UpperBound, tightened by the bound proven by the search
+	long getBound() const
+	{
+		return upperBound != nullptr ? std::min(upperBound->getValue(), searchBound) : searchBound;
+	}
+
+protected:
+
+	// True when the search can stop: the objective value reaches the --target, the --gap, or the upper bound itself
+	bool reachedGoal(long objective, const Parameters& parameters) const
+	{
+		if (objective >= parameters.targetObjective)
+			return true;
+		if (upperBound == nullptr)
+			return false;
+
+		return objective >= upperBound->getValue() ||
+			(parameters.targetGap >= 0 && UpperBound::getGap(objective, upperBound->getValue()) <= parameters.targetGap);
+	}
+
+	// Statistics of the search: cleared at its start, the improvements are recorded by any thread as they are published
+	void startStatistics()
+	{
+		statistics = SearchStatistics();
+		statisticsStartTime = getCurrentTime_ms();
+	}
+
+	double getSearchTime_s() const { return (getCurrentTime_ms() - statisticsStartTime) / 1000.0; }
+
+	void recordImprovement(long objective)
+	{
+		lock_guard<mutex> lock(statisticsMutex);
+
+		// Concurrent improvements may be recorded out of order, only the increasing ones are kept
+		if (statistics.improvements.empty() || objective > statistics.improvements.back().second)
+			statistics.improvements.emplace_back(getSearchTime_s(), objective);
+	}
 
 };
+
+
+Algorithm* createAlgorithm(AlgorithmType type, Instance& inst);		// Instantiates the search engine selected with --algorithm
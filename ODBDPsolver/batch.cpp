@@ -0,0 +1,322 @@
+#include "batch.hpp"
+#include "upperbound.hpp"
+#include "workpool.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+
+Batch::Batch(const Parameters& parameters)
+	: parameters(parameters),
+	threadsPerJob(1),
+	evaluationThreadsPerJob(0),
+	nextJob(0),
+	completedJobs(0)
+{
+}
+
+Batch::~Batch()
+{
+}
+
+
+void Batch::load(const std::string& path)
+{
+	namespace fs = std::filesystem;
+	jobs.clear();
+	results.clear();
+
+	if (fs::is_directory(path))
+	{
+		// All the instance files of the directory, in name order
+		vector<string> fileNames;
+		for (const fs::directory_entry& entry : fs::directory_iterator(path))
+		{
+			string extension = entry.path().extension().string();
+			if (entry.is_regular_file() && (extension == ".odbdp" || extension == ".odbdpb"))
+				fileNames.push_back(entry.path().string());
+		}
+		std::sort(fileNames.begin(), fileNames.end());
+
+		for (const string& fileName : fileNames)
+			addJob(fileName, parameters.timeLimit);
+	}
+	else
+	{
+		// Manifest: an instance file per line, optionally followed by its time limit (as with -t);
+		// the paths are relative to the manifest, and everything after a '#' is a comment
+		ifstream manifest(path);
+		if (!manifest)
+			throw exception(("Error: unable to open the batch manifest '" + path + "'").c_str());
+
+		fs::path directory = fs::path(path).parent_path();
+		string line;
+		int lineNumber = 0;
+		while (getline(manifest, line))
+		{
+			lineNumber++;
+			istringstream fields(line.substr(0, line.find('#')));
+			string fileName, timeLimit, extra;
+
+			if (!(fields >> fileName))
+				continue;
+			if (fields >> timeLimit && fields >> extra)
+				throw exception(("Error in the batch manifest at line " + to_string(lineNumber) + ": too many fields").c_str());
+
+			addJob((directory / fileName).string(), timeLimit.empty() ? parameters.timeLimit : parseTimeLimit(timeLimit.c_str()));
+		}
+	}
+
+	if (jobs.empty())
+		throw exception(("Error: no instances to solve in '" + path + "'").c_str());
+}
+
+
+void Batch::addJob(const std::string& fileName, unsigned int timeLimit)
+{
+	// The benchmark replaces the time limit with its budgets, and repeats each run
+	vector<unsigned int> timeLimits = parameters.benchmarkBudgets;
+	if (parameters.benchmarkRuns == 0 || timeLimits.empty())
+		timeLimits = { timeLimit };
+	int runs = std::max((int)parameters.benchmarkRuns, 1);
+
+	for (unsigned int limit : timeLimits)
+	{
+		for (int run = 1; run <= runs; run++)
+		{
+			// Instances solved more than once get numbered output files; the benchmark writes them
+			// in a directory of its own, next to its result files, rather than among the instances
+			int occurrences = 1;
+			for (const Job& job : jobs)
+				occurrences += (job.fileName == fileName) ? 1 : 0;
+
+			string outputFileName = fileName + (occurrences > 1 ? "_" + to_string(occurrences) : "") + "_OMAAL_group04.sol";
+			if (parameters.benchmarkRuns > 0)
+				outputFileName = (std::filesystem::path(getSolutionDirectory()) / std::filesystem::path(outputFileName).filename()).string();
+
+			jobs.push_back({ fileName, outputFileName, limit, run, parameters.seed + run - 1 });
+			results.push_back({ string(), 0, 0, 0, 0, 0, 0, 0, SearchStatistics() });
+		}
+	}
+}
+
+
+void Batch::run()
+{
+	long long startingTime = getCurrentTime_ms();
+
+	// Jobs running at the same time, splitting the threads among them: never more jobs than threads, so that
+	// the islands of all the jobs together do not outnumber them; benchmark runs are measured one at a time
+	// with all the threads, unless --batch-jobs is given
+	unsigned int slots = (parameters.batchJobs > 0) ? parameters.batchJobs : (parameters.benchmarkRuns > 0) ? 1 : parameters.nThreads;
+	slots = std::max(std::min({ slots, (unsigned int)jobs.size(), parameters.nThreads }), 1u);
+	threadsPerJob = std::max(parameters.nThreads / slots, 1u);
+	evaluationThreadsPerJob = parameters.evaluationThreads / slots;
+
+	fprintf_s(stdout, "Running %d jobs, %u at a time with %u threads each\n", (int)jobs.size(), slots, threadsPerJob);
+
+	if (parameters.benchmarkRuns > 0)
+	{
+		std::error_code error;
+		std::filesystem::create_directories(getSolutionDirectory(), error);
+		if (error)
+			throw exception(("Error: unable to create the directory '" + getSolutionDirectory() + "' for the benchmark solutions").c_str());
+	}
+
+	// Instances are kept in memory until their last job completes
+	for (const Job& job : jobs)
+		instances[job.fileName].pendingJobs++;
+
+	nextJob = 0, completedJobs = 0;
+	{
+		WorkPool scheduler(slots);
+
+		// Each task solves the next job of the list, so the jobs start in the listed order whichever worker runs them
+		for (size_t i = 0; i < jobs.size(); i++)
+			scheduler.submit([this]() { solve(nextJob++); });
+
+		unique_lock<mutex> lock(progressMutex);
+		jobCompleted.wait(lock, [this] { return completedJobs == jobs.size(); });
+	}
+
+	double elapsed_s = (getCurrentTime_ms() - startingTime) / 1000.0;
+	fprintf_s(stdout, "\n");
+	writeSummary(stdout, elapsed_s);
+
+	FILE* fl = nullptr;
+	fopen_s(&fl, parameters.summaryFileName.c_str(), "w");
+	if (fl == nullptr)
+		throw exception(("Error: unable to write the batch summary on file '" + parameters.summaryFileName + "'").c_str());
+
+	writeSummary(fl, elapsed_s);
+	fclose(fl);
+	fprintf_s(stdout, "Summary written on file '%s'\n", parameters.summaryFileName.c_str());
+}
+
+
+void Batch::solve(int job)
+{
+	const Job& current = jobs[job];
+	Result& result = results[job];
+
+	// Once the batch is interrupted, the jobs not started yet are skipped
+	if (StopToken::getInterruptSignal() != 0)
+		result.status = "skipped";
+	else
+		runJob(current, result);
+
+	releaseInstance(current.fileName);
+
+	// Report the progress, and wake up the batch once all the jobs have completed
+	lock_guard<mutex> lock(progressMutex);
+	completedJobs++;
+	if (isCompleted(result.status))
+		fprintf_s(stdout, "[%d/%d] %s: %s, objective function value = %ld\n", (int)completedJobs, (int)jobs.size(),
+			current.fileName.c_str(), result.status.c_str(), result.objective);
+	else
+		fprintf_s(stdout, "[%d/%d] %s: %s\n", (int)completedJobs, (int)jobs.size(), current.fileName.c_str(), result.status.c_str());
+	jobCompleted.notify_one();
+}
+
+
+void Batch::runJob(const Job& current, Result& result)
+{
+	try
+	{
+		shared_ptr<Instance> instance = acquireInstance(current.fileName);
+
+		Parameters jobParameters = parameters;
+		jobParameters.inputFileName = current.fileName;
+		jobParameters.outputFileName = current.outputFileName;
+		jobParameters.timeLimit = current.timeLimit;
+		jobParameters.nThreads = threadsPerJob;
+		jobParameters.evaluationThreads = evaluationThreadsPerJob;
+		jobParameters.seed = current.seed;
+		jobParameters.verbose = false;
+
+		UpperBound bound(*instance);
+		bound.compute();
+
+		long long startingTime = getCurrentTime_ms();
+		unique_ptr<Algorithm> solver(createAlgorithm(jobParameters.algorithm, *instance));
+		solver->setUpperBound(&bound);
+		Solution solution = solver->run(jobParameters);
+
+		result.nQueries = instance->nQueries;
+		result.nIndexes = instance->originalIndexes;
+		result.nConfigs = instance->originalConfigs;
+		result.objective = solution.getObjFunctionValue();
+		result.memory = solution.getMemoryCost();
+		result.upperBound = solver->getBound();
+		result.time_s = (getCurrentTime_ms() - startingTime) / 1000.0;
+		result.statistics = solver->getStatistics();
+
+		StopToken::Reason reason = solver->getStopReason();
+		if (reason == StopToken::NONE || result.objective >= result.upperBound)
+			result.status = "optimal";
+		else if (reason == StopToken::GOAL)
+			result.status = "goal reached";
+		else if (reason == StopToken::INTERRUPT)
+			result.status = "interrupted";
+		else if (reason == StopToken::BUDGET)
+			result.status = "budget exhausted";
+		else
+			result.status = "time limit";
+	}
+	catch (std::exception& e)
+	{
+		result.status = string("error: ") + e.what();
+		result.status.erase(result.status.find_last_not_of(" \n") + 1);
+	}
+}
+
+
+shared_ptr<Instance> Batch::acquireInstance(const std::string& fileName)
+{
+	promise<shared_ptr<Instance>> loading;
+	shared_future<shared_ptr<Instance>> loaded;
+	bool loader = false;
+
+	{
+		lock_guard<mutex> lock(instancesMutex);
+		SharedInstance& shared = instances[fileName];
+		if (!shared.instance.valid())
+			shared.instance = loading.get_future().share(), loader = true;
+		loaded = shared.instance;
+	}
+
+	// The first job of the instance loads it, the others wait for it
+	if (loader)
+	{
+		try
+		{
+			shared_ptr<Instance> instance = make_shared<Instance>();
+			instance->readInputFile(fileName);
+			if (parameters.presolve)
+				instance->presolve();
+			loading.set_value(instance);
+		}
+		catch (...)
+		{
+			loading.set_exception(current_exception());
+		}
+	}
+
+	return loaded.get();
+}
+
+
+void Batch::releaseInstance(const std::string& fileName)
+{
+	lock_guard<mutex> lock(instancesMutex);
+	SharedInstance& shared = instances[fileName];
+
+	// The instance is freed when the last job holding it returns
+	if (--shared.pendingJobs == 0)
+		shared.instance = shared_future<shared_ptr<Instance>>();
+}
+
+
+bool Batch::isCompleted(const string& status)
+{
+	return status != "skipped" && status.compare(0, 6, "error:") != 0;
+}
+
+
+void Batch::writeSummary(FILE* stream, double elapsed_s) const
+{
+	int nameWidth = 8;
+	for (const Job& job : jobs)
+		nameWidth = std::max(nameWidth, (int)job.fileName.length());
+
+	fprintf_s(stream, "%-*s %7s %7s %7s %9s %10s %9s %11s %7s %8s  %s\n", nameWidth, "Instance",
+		"Queries", "Indexes", "Configs", "Limit (s)", "Objective", "Memory", "Upper bound", "Gap (%)", "Time (s)", "Status");
+
+	int solved = 0;
+	double totalGap = 0;
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const Result& result = results[i];
+
+		if (!isCompleted(result.status))
+		{
+			fprintf_s(stream, "%-*s %7s %7s %7s %9.3f %10s %9s %11s %7s %8s  %s\n", nameWidth, jobs[i].fileName.c_str(),
+				"-", "-", "-", jobs[i].timeLimit / 1000.0, "-", "-", "-", "-", "-", result.status.c_str());
+			continue;
+		}
+
+		double gap = UpperBound::getGap(result.objective, result.upperBound);
+		fprintf_s(stream, "%-*s %7d %7d %7d %9.3f %10ld %9d %11ld %7.2f %8.2f  %s\n", nameWidth, jobs[i].fileName.c_str(),
+			result.nQueries, result.nIndexes, result.nConfigs, jobs[i].timeLimit / 1000.0, result.objective,
+			result.memory, result.upperBound, gap, result.time_s, result.status.c_str());
+
+		solved++;
+		totalGap += gap;
+	}
+
+	fprintf_s(stream, "%d of %d instances solved in %.2f s, average gap %.2f%%\n",
+		solved, (int)jobs.size(), elapsed_s, solved > 0 ? totalGap / solved : 0.0);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <future>
+#include <condition_variable>
+#include <atomic>
+
+#include "utilities.hpp"
+#include "algorithm.hpp"
+
+
+using namespace std;
+
+
+/*
+** Batch solves in a single process all the instances found in a directory (*.odbdp and *.odbdpb files),
+** or listed in a manifest file with an optional time limit each. Every instance is a task of a shared WorkPool:
+** a job starts as soon as a slot frees up, idle slots steal the pending ones, and each job runs the selected engine
+** with its share of the threads (and of the --eval-threads), so the jobs together never run more islands than -j.
+** Instances listed more than once are loaded and presolved only once, then shared read-only by their jobs until
+** the last one completes. The results are collected in a summary table.
+** In benchmark mode, every instance is solved --benchmark times with each of the --budgets
+*/
+class Batch
+{
+
+public:
+
+	// Instance to solve, with its own time limit and output file
+	struct Job {
+		string fileName;
+		string outputFileName;
+		unsigned int timeLimit;		// ms
+		int run;					// Repetition of the instance with the same time limit, from 1
+		uint64_t seed;				// With --seed, the one of the run: repetitions differ, and each one can be replayed
+	};
+
+	// Outcome of a job, one row of the summary table
+	struct Result {
+		string status;				// Empty until the job has run
+		int nQueries;
+		int nIndexes;
+		int nConfigs;
+		long objective;
+		int memory;
+		long upperBound;
+		double time_s;
+		SearchStatistics statistics;
+	};
+
+	// Instance loaded once for all the jobs that solve it
+	struct SharedInstance {
+		shared_future<shared_ptr<Instance>> instance;
+		int pendingJobs;
+	};
+
+private:
+
+	const Parameters& parameters;
+	vector<Job> jobs;
+	vector<Result> results;
+	unsigned int threadsPerJob;				// Islands of each job
+	unsigned int evaluationThreadsPerJob;
+	atomic<int> nextJob;
+
+	mutex progressMutex;
+	condition_variable jobCompleted;
+	size_t completedJobs;
+
+	mutex instancesMutex;
+	map<string, SharedInstance> instances;
+
+
+public:
+
+	Batch(const Parameters& parameters);
+	~Batch();
+
+	void load(const std::string& path);		// Jobs from a directory or a manifest file
+	void run();								// Solves all the jobs, then writes the summary table
+
+	void writeSummary(FILE* stream, double elapsed_s) const;
+
+	const vector<Job>& getJobs() const { return jobs; }
+	const vector<Result>& getResults() const { return results; }
+	static bool isCompleted(const string& status);		// Jobs that produced a solution, as opposed to skipped or failed ones
+	string getSolutionDirectory() const { return parameters.benchmarkPrefix + "_solutions"; }		// Of the benchmark runs
+
+private:
+
+	void addJob(const std::string& fileName, unsigned int timeLimit);
+	void solve(int job);
+	void runJob(const Job& current, Result& result);
+	shared_ptr<Instance> acquireInstance(const std::string& fileName);
+	void releaseInstance(const std::string& fileName);
+
+};
@@ -0,0 +1,481 @@
+#include "benchmark.hpp"
+#include "upperbound.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <cmath>
+#include <map>
+
+
+#define SUMMARY_HEADER "instance,time_limit_s,runs,target,best_objective,mean_objective,mean_time_to_best_s,"\
+	"median_time_to_target_s,reached_target,generations_per_s,evaluations_per_s,regressions"
+
+
+static FILE* openResultFile(const string& fileName)
+{
+	FILE* fl = nullptr;
+	fopen_s(&fl, fileName.c_str(), "w");
+	if (fl == nullptr)
+		throw exception(("Error: unable to write the benchmark results on file '" + fileName + "'").c_str());
+
+	return fl;
+}
+
+static string csvField(const string& text)		// Quoted only when needed, error messages may contain commas
+{
+	if (text.find_first_of(",\"") == string::npos)
+		return text;
+
+	string quoted = "\"";
+	for (char c : text)
+		quoted += (c == '"') ? string("\"\"") : string(1, c);
+	return quoted + "\"";
+}
+
+static vector<string> csvFields(const string& line)		// Splits a row written with csvField
+{
+	vector<string> fields(1);
+	bool quoted = false;
+	for (size_t i = 0; i < line.length(); i++)
+	{
+		char c = line[i];
+		if (quoted && c == '"' && i + 1 < line.length() && line[i + 1] == '"')
+			fields.back() += line[++i];
+		else if (c == '"')
+			quoted = !quoted;
+		else if (c == ',' && !quoted)
+			fields.emplace_back();
+		else
+			fields.back() += c;
+	}
+
+	return fields;
+}
+
+static string jsonString(const string& text)
+{
+	string quoted = "\"";
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+
+Benchmark::Benchmark(const Parameters& parameters)
+	: parameters(parameters),
+	batch(parameters),
+	regressions(0)
+{
+}
+
+Benchmark::~Benchmark()
+{
+}
+
+
+void Benchmark::load(const std::string& path)
+{
+	batch.load(path);
+	if (parameters.baselineFileName.length() > 0)
+		loadBaseline();
+}
+
+
+int Benchmark::run()
+{
+	batch.run();
+
+	summarize();
+	compareBaseline();
+
+	string prefix = parameters.benchmarkPrefix;
+	writeRuns(prefix + "_runs.csv");
+	writeTrace(prefix + "_trace.csv");
+	writeSummary(prefix + "_summary.csv");
+	writeJson(prefix + ".json");
+
+	fprintf_s(stdout, "\n");
+	printSummary();
+	fprintf_s(stdout, "Benchmark results written on files '%s_runs.csv', '%s_trace.csv', '%s_summary.csv' and '%s.json',"
+		" solutions in '%s'\n", prefix.c_str(), prefix.c_str(), prefix.c_str(), prefix.c_str(), batch.getSolutionDirectory().c_str());
+
+	return regressions;
+}
+
+
+void Benchmark::loadBaseline()
+{
+	ifstream input(parameters.baselineFileName);
+	if (!input)
+		throw exception(("Error: unable to open the benchmark baseline '" + parameters.baselineFileName + "'").c_str());
+
+	// The baseline is the summary file of a previous benchmark
+	string line;
+	if (!getline(input, line) || line.compare(0, strlen(SUMMARY_HEADER), SUMMARY_HEADER) != 0)
+		throw exception(("Error: '" + parameters.baselineFileName + "' is not the summary of a benchmark").c_str());
+
+	baseline.clear();
+	int lineNumber = 1;
+	while (getline(input, line))
+	{
+		lineNumber++;
+		if (line.empty())
+			continue;
+
+		vector<string> fields = csvFields(line);
+		if (fields.size() < 11)
+			throw exception(("Error in the benchmark baseline at line " + to_string(lineNumber) + ": missing fields").c_str());
+
+		Aggregate entry;
+		entry.instance = fields[0];
+		entry.timeLimit = (unsigned int)std::lround(atof(fields[1].c_str()) * 1000);
+		entry.runs = atoi(fields[2].c_str());
+		entry.target = atol(fields[3].c_str());
+		entry.bestObjective = atol(fields[4].c_str());
+		entry.meanObjective = atof(fields[5].c_str());
+		entry.meanTimeToBest = atof(fields[6].c_str());
+		entry.medianTimeToTarget = fields[7].empty() ? -1 : atof(fields[7].c_str());
+		entry.reachedTarget = atoi(fields[8].c_str());
+		entry.generationsPerSecond = atof(fields[9].c_str());
+		entry.evaluationsPerSecond = atof(fields[10].c_str());
+		baseline.push_back(entry);
+	}
+}
+
+
+void Benchmark::summarize()
+{
+	const vector<Batch::Job>& jobs = batch.getJobs();
+	const vector<Batch::Result>& results = batch.getResults();
+
+	// Targets come from the best objective value known for each instance, whatever the time limit
+	map<string, long> bestKnown;
+	for (const Aggregate& entry : baseline)
+		bestKnown[entry.instance] = std::max(bestKnown[entry.instance], entry.bestObjective);
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		string instance = getInstanceName(jobs[i].fileName);
+		if (Batch::isCompleted(results[i].status))
+			bestKnown[instance] = std::max(bestKnown[instance], results[i].objective);
+	}
+
+	// Runs grouped by instance and time limit, in the order of the jobs
+	vector<vector<double>> times;
+	summary.clear();
+	timesToTarget.assign(jobs.size(), -1);
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		string instance = getInstanceName(jobs[i].fileName);
+		long target = (long)std::ceil(bestKnown[instance] * BENCHMARK_TARGET_PERCENT / 100.0);
+
+		size_t row = 0;
+		while (row < summary.size() && (summary[row].instance != instance || summary[row].timeLimit != jobs[i].timeLimit))
+			row++;
+		if (row == summary.size())
+		{
+			summary.push_back({ instance, jobs[i].timeLimit, 0, target, 0, 0, 0, -1, 0, 0, 0, string() });
+			times.emplace_back();
+		}
+
+		const Batch::Result& result = results[i];
+		if (!Batch::isCompleted(result.status))
+			continue;
+
+		Aggregate& entry = summary[row];
+		double time_s = std::max(result.statistics.time_s, 0.001);
+		timesToTarget[i] = getTimeToTarget(result.statistics, target);
+
+		entry.bestObjective = (entry.runs == 0) ? result.objective : std::max(entry.bestObjective, result.objective);
+		entry.runs++;
+		entry.meanObjective += result.objective;
+		entry.meanTimeToBest += getTimeToBest(result.statistics);
+		entry.reachedTarget += (timesToTarget[i] >= 0) ? 1 : 0;
+		entry.generationsPerSecond += result.statistics.generations / time_s;
+		entry.evaluationsPerSecond += result.statistics.evaluations / time_s;
+		times[row].push_back(timesToTarget[i] >= 0 ? timesToTarget[i] : numeric_limits<double>::infinity());
+	}
+
+	for (size_t row = 0; row < summary.size(); row++)
+	{
+		Aggregate& entry = summary[row];
+		if (entry.runs == 0)
+			continue;
+
+		entry.meanObjective /= entry.runs;
+		entry.meanTimeToBest /= entry.runs;
+		entry.generationsPerSecond /= entry.runs;
+		entry.evaluationsPerSecond /= entry.runs;
+
+		// The missed targets count as infinite times, the median is defined while most runs reach the target
+		vector<double>& sorted = times[row];
+		std::sort(sorted.begin(), sorted.end());
+		size_t n = sorted.size();
+		double median = (n % 2 == 1) ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+		entry.medianTimeToTarget = std::isinf(median) ? -1 : median;
+	}
+}
+
+
+void Benchmark::compareBaseline()
+{
+	regressions = 0;
+	double threshold = 1 - parameters.regressionTolerance / 100;
+
+	for (Aggregate& entry : summary)
+	{
+		const Aggregate* reference = findBaseline(entry.instance, entry.timeLimit);
+		if (reference == nullptr)
+			continue;
+
+		vector<string> worse;
+		if (entry.runs == 0 && reference->runs > 0)
+			worse.push_back("no runs completed");
+		else
+		{
+			if (entry.meanObjective < reference->meanObjective * threshold)
+				worse.push_back("objective");
+			if (entry.generationsPerSecond < reference->generationsPerSecond * threshold)
+				worse.push_back("generations/s");
+			if (entry.evaluationsPerSecond < reference->evaluationsPerSecond * threshold)
+				worse.push_back("evaluations/s");
+		}
+
+		entry.regressions.clear();
+		for (size_t i = 0; i < worse.size(); i++)
+			entry.regressions += (i > 0 ? " " : "") + worse[i];
+		regressions += worse.empty() ? 0 : 1;
+	}
+}
+
+
+void Benchmark::writeRuns(const string& fileName) const
+{
+	const vector<Batch::Job>& jobs = batch.getJobs();
+	const vector<Batch::Result>& results = batch.getResults();
+	FILE* fl = openResultFile(fileName);
+
+	fprintf_s(fl, "instance,time_limit_s,run,seed,status,objective,memory,upper_bound,gap,time_s,time_to_best_s,time_to_target_s,"
+		"improvements,generations,generations_per_s,evaluations,evaluations_per_s\n");
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const Batch::Result& result = results[i];
+		fprintf_s(fl, "%s,%.3f,%d,", csvField(getInstanceName(jobs[i].fileName)).c_str(), jobs[i].timeLimit / 1000.0, jobs[i].run);
+		if (parameters.fixedSeed)
+			fprintf_s(fl, "%llu", (unsigned long long)jobs[i].seed);
+		fprintf_s(fl, ",%s,", csvField(result.status).c_str());
+
+		if (!Batch::isCompleted(result.status))
+		{
+			fprintf_s(fl, ",,,,,,,,,,,\n");
+			continue;
+		}
+
+		double time_s = std::max(result.statistics.time_s, 0.001);
+		fprintf_s(fl, "%ld,%d,%ld,%.4f,%.3f,%.3f,", result.objective, result.memory, result.upperBound,
+			UpperBound::getGap(result.objective, result.upperBound), result.statistics.time_s, getTimeToBest(result.statistics));
+		if (timesToTarget[i] >= 0)
+			fprintf_s(fl, "%.3f", timesToTarget[i]);
+		fprintf_s(fl, ",%d,%llu,%.1f,%llu,%.1f\n", (int)result.statistics.improvements.size(),
+			result.statistics.generations, result.statistics.generations / time_s,
+			result.statistics.evaluations, result.statistics.evaluations / time_s);
+	}
+
+	fclose(fl);
+}
+
+
+void Benchmark::writeTrace(const string& fileName) const
+{
+	const vector<Batch::Job>& jobs = batch.getJobs();
+	const vector<Batch::Result>& results = batch.getResults();
+	FILE* fl = openResultFile(fileName);
+
+	// Objective over time: a row for each improvement of each run
+	fprintf_s(fl, "instance,time_limit_s,run,time_s,objective\n");
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		string instance = csvField(getInstanceName(jobs[i].fileName));
+		for (const pair<double, long>& improvement : results[i].statistics.improvements)
+			fprintf_s(fl, "%s,%.3f,%d,%.3f,%ld\n", instance.c_str(), jobs[i].timeLimit / 1000.0, jobs[i].run,
+				improvement.first, improvement.second);
+	}
+
+	fclose(fl);
+}
+
+
+void Benchmark::writeSummary(const string& fileName) const
+{
+	FILE* fl = openResultFile(fileName);
+
+	fprintf_s(fl, "%s\n", SUMMARY_HEADER);
+	for (const Aggregate& entry : summary)
+	{
+		fprintf_s(fl, "%s,%.3f,%d,%ld,%ld,%.2f,%.3f,", csvField(entry.instance).c_str(), entry.timeLimit / 1000.0,
+			entry.runs, entry.target, entry.bestObjective, entry.meanObjective, entry.meanTimeToBest);
+		if (entry.medianTimeToTarget >= 0)
+			fprintf_s(fl, "%.3f", entry.medianTimeToTarget);
+		fprintf_s(fl, ",%d,%.1f,%.1f,%s\n", entry.reachedTarget, entry.generationsPerSecond, entry.evaluationsPerSecond,
+			csvField(entry.regressions).c_str());
+	}
+
+	fclose(fl);
+}
+
+
+void Benchmark::writeJson(const string& fileName) const
+{
+	const vector<Batch::Job>& jobs = batch.getJobs();
+	const vector<Batch::Result>& results = batch.getResults();
+	FILE* fl = openResultFile(fileName);
+
+	fprintf_s(fl, "{\n\t\"algorithm\": \"%s\",\n\t\"threads\": %u,\n\t\"target_percent\": %d,\n\t\"tolerance_percent\": %g,\n",
+		parameters.algorithm == ALGORITHM_BRANCH_AND_BOUND ? "bnb" : "ga", parameters.nThreads,
+		BENCHMARK_TARGET_PERCENT, parameters.regressionTolerance);
+	fprintf_s(fl, "\t\"baseline\": %s,\n", parameters.baselineFileName.length() > 0 ?
+		jsonString(parameters.baselineFileName).c_str() : "null");
+
+	fprintf_s(fl, "\t\"runs\": [");
+	for (size_t i = 0; i < jobs.size(); i++)
+	{
+		const Batch::Result& result = results[i];
+		fprintf_s(fl, "%s\n\t\t{ \"instance\": %s, \"file\": %s, \"time_limit_s\": %.3f, \"run\": %d, \"status\": %s",
+			i > 0 ? "," : "", jsonString(getInstanceName(jobs[i].fileName)).c_str(), jsonString(jobs[i].fileName).c_str(),
+			jobs[i].timeLimit / 1000.0, jobs[i].run, jsonString(result.status).c_str());
+		if (parameters.fixedSeed)
+			fprintf_s(fl, ", \"seed\": %llu", (unsigned long long)jobs[i].seed);
+
+		if (Batch::isCompleted(result.status))
+		{
+			double time_s = std::max(result.statistics.time_s, 0.001);
+			fprintf_s(fl, ", \"objective\": %ld, \"memory\": %d, \"upper_bound\": %ld, \"gap\": %.4f, \"time_s\": %.3f,"
+				" \"time_to_best_s\": %.3f, \"time_to_target_s\": ", result.objective, result.memory, result.upperBound,
+				UpperBound::getGap(result.objective, result.upperBound), result.statistics.time_s, getTimeToBest(result.statistics));
+			if (timesToTarget[i] >= 0)
+				fprintf_s(fl, "%.3f", timesToTarget[i]);
+			else
+				fprintf_s(fl, "null");
+			fprintf_s(fl, ", \"generations\": %llu, \"generations_per_s\": %.1f, \"evaluations\": %llu, \"evaluations_per_s\": %.1f,",
+				result.statistics.generations, result.statistics.generations / time_s,
+				result.statistics.evaluations, result.statistics.evaluations / time_s);
+
+			// Objective over time, as [time_s, objective] pairs
+			fprintf_s(fl, " \"trace\": [");
+			for (size_t k = 0; k < result.statistics.improvements.size(); k++)
+				fprintf_s(fl, "%s[%.3f, %ld]", k > 0 ? ", " : "", result.statistics.improvements[k].first,
+					result.statistics.improvements[k].second);
+			fprintf_s(fl, "]");
+		}
+		fprintf_s(fl, " }");
+	}
+	fprintf_s(fl, "\n\t],\n");
+
+	fprintf_s(fl, "\t\"summary\": [");
+	for (size_t i = 0; i < summary.size(); i++)
+	{
+		const Aggregate& entry = summary[i];
+		fprintf_s(fl, "%s\n\t\t{ \"instance\": %s, \"time_limit_s\": %.3f, \"runs\": %d, \"target\": %ld, \"best_objective\": %ld,"
+			" \"mean_objective\": %.2f, \"mean_time_to_best_s\": %.3f, \"median_time_to_target_s\": ", i > 0 ? "," : "",
+			jsonString(entry.instance).c_str(), entry.timeLimit / 1000.0, entry.runs, entry.target, entry.bestObjective,
+			entry.meanObjective, entry.meanTimeToBest);
+		if (entry.medianTimeToTarget >= 0)
+			fprintf_s(fl, "%.3f", entry.medianTimeToTarget);
+		else
+			fprintf_s(fl, "null");
+		fprintf_s(fl, ", \"reached_target\": %d, \"generations_per_s\": %.1f, \"evaluations_per_s\": %.1f, \"regressions\": %s }",
+			entry.reachedTarget, entry.generationsPerSecond, entry.evaluationsPerSecond, jsonString(entry.regressions).c_str());
+	}
+	fprintf_s(fl, "\n\t],\n\t\"regressions\": %d\n}\n", regressions);
+
+	fclose(fl);
+}
+
+
+void Benchmark::printSummary() const
+{
+	int nameWidth = 8;
+	for (const Aggregate& entry : summary)
+		nameWidth = std::max(nameWidth, (int)entry.instance.length());
+
+	fprintf_s(stdout, "%-*s %9s %4s %10s %12s %8s %8s %7s %13s %13s  %s\n", nameWidth, "Instance", "Limit (s)", "Runs",
+		"Best", "Mean", "TTB (s)", "TTT (s)", "Reached", "Generations/s", "Evaluations/s", "Change from the baseline");
+
+	for (const Aggregate& entry : summary)
+	{
+		char ttt[32] = "-";
+		if (entry.medianTimeToTarget >= 0)
+			sprintf_s(ttt, sizeof(ttt), "%.3f", entry.medianTimeToTarget);
+
+		fprintf_s(stdout, "%-*s %9.3f %4d %10ld %12.1f %8.3f %8s %3d/%-3d %13.1f %13.1f  ", nameWidth, entry.instance.c_str(),
+			entry.timeLimit / 1000.0, entry.runs, entry.bestObjective, entry.meanObjective, entry.meanTimeToBest, ttt,
+			entry.reachedTarget, entry.runs, entry.generationsPerSecond, entry.evaluationsPerSecond);
+
+		// Relative changes of the objective and of the throughput, then the measures beyond the tolerance
+		const Aggregate* reference = findBaseline(entry.instance, entry.timeLimit);
+		if (reference == nullptr)
+			fprintf_s(stdout, "-");
+		else
+		{
+			auto change = [](double now, double before) { return before != 0 ? 100.0 * (now - before) / before : 0.0; };
+			fprintf_s(stdout, "objective %+.2f%%, generations/s %+.1f%%, evaluations/s %+.1f%%",
+				change(entry.meanObjective, reference->meanObjective),
+				change(entry.generationsPerSecond, reference->generationsPerSecond),
+				change(entry.evaluationsPerSecond, reference->evaluationsPerSecond));
+			if (!entry.regressions.empty())
+				fprintf_s(stdout, "  REGRESSION: %s", entry.regressions.c_str());
+		}
+		fprintf_s(stdout, "\n");
+	}
+
+	fprintf_s(stdout, "Target of the time-to-target (TTT) measures: %d%% of the best objective value known for the instance\n",
+		BENCHMARK_TARGET_PERCENT);
+	if (parameters.baselineFileName.length() > 0)
+		fprintf_s(stdout, "%d regressions beyond the tolerance of %g%% from the baseline '%s'\n",
+			regressions, parameters.regressionTolerance, parameters.baselineFileName.c_str());
+}
+
+
+const Benchmark::Aggregate* Benchmark::findBaseline(const string& instance, unsigned int timeLimit) const
+{
+	for (const Aggregate& entry : baseline)
+	{
+		if (entry.instance == instance && entry.timeLimit == timeLimit)
+			return &entry;
+	}
+
+	return nullptr;
+}
+
+
+string Benchmark::getInstanceName(const string& fileName)
+{
+	return std::filesystem::path(fileName).filename().string();
+}
+
+
+double Benchmark::getTimeToBest(const SearchStatistics& statistics)
+{
+	return statistics.improvements.empty() ? 0 : statistics.improvements.back().first;
+}
+
+
+double Benchmark::getTimeToTarget(const SearchStatistics& statistics, long target)
+{
+	if (target <= 0)
+		return 0;
+
+	for (const pair<double, long>& improvement : statistics.improvements)
+	{
+		if (improvement.second >= target)
+			return improvement.first;
+	}
+
+	return -1;
+}
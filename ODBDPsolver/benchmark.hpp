@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "utilities.hpp"
+#include "batch.hpp"
+
+
+#define BENCHMARK_TARGET_PERCENT 99		// Target of the time-to-target measures, as a share of the best objective value known
+
+using namespace std;
+
+
+/*
+** Benchmark measures the solver on a set of instances: the Batch solves each one --benchmark times with every
+** time limit of --budgets, and the statistics of the searches give the time to the best solution, the time to
+** reach BENCHMARK_TARGET_PERCENT of the best objective value known, the objective over time and the throughput.
+** The runs are written as CSV and JSON files; the summary of each instance and time limit is also the baseline
+** format, so a stored summary flags the rows of later benchmarks whose objective or throughput dropped beyond --tolerance
+*/
+class Benchmark
+{
+
+	// Runs of an instance with the same time limit, one row of the summary (and of the baseline)
+	struct Aggregate {
+		string instance;				// File name, without the directory
+		unsigned int timeLimit;			// ms
+		int runs;						// Runs completed
+		long target;
+		long bestObjective;
+		double meanObjective;
+		double meanTimeToBest;			// s
+		double medianTimeToTarget;		// s, negative if half of the runs or more missed the target
+		int reachedTarget;
+		double generationsPerSecond;
+		double evaluationsPerSecond;
+		string regressions;				// Measures worse than the baseline beyond the tolerance
+	};
+
+private:
+
+	const Parameters& parameters;
+	Batch batch;
+	vector<double> timesToTarget;		// Of each job, negative if missed
+	vector<Aggregate> summary;
+	vector<Aggregate> baseline;
+	int regressions;
+
+
+public:
+
+	Benchmark(const Parameters& parameters);
+	~Benchmark();
+
+	void load(const std::string& path);		// Instances from a directory or a manifest file, as in batch mode
+	int run();								// Runs the benchmark and writes the results, returns the rows flagged as regressions
+
+private:
+
+	void loadBaseline();
+	void summarize();
+	void compareBaseline();
+
+	// Result files, named after the --bench-output prefix
+	void writeRuns(const string& fileName) const;
+	void writeTrace(const string& fileName) const;
+	void writeSummary(const string& fileName) const;
+	void writeJson(const string& fileName) const;
+	void printSummary() const;
+
+	const Aggregate* findBaseline(const string& instance, unsigned int timeLimit) const;
+	static string getInstanceName(const string& fileName);
+	static double getTimeToBest(const SearchStatistics& statistics);
+	static double getTimeToTarget(const SearchStatistics& statistics, long target);
+
+};
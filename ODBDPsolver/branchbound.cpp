@@ -0,0 +1,303 @@
+#include "branchbound.hpp"
+#include "genetic.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+
+
+BranchBound::BranchBound(Instance& inst)
+	: Algorithm(inst),
+	parameters(nullptr),
+	exploredNodes(0),
+	openBound(LONG_MIN),
+	incumbentObjective(0)
+{
+}
+
+BranchBound::~BranchBound()
+{
+}
+
+
+Solution BranchBound::run(const Parameters& parameters)
+{
+	this->parameters = &parameters;
+	stopToken.setBudget(parameters.timeLimit);
+	startStatistics();
+
+	// Warm start: a short run of the genetic algorithm provides the initial incumbent
+	Parameters warmStart = parameters;
+	warmStart.timeLimit = (unsigned int)((unsigned long long)parameters.timeLimit * BNB_WARM_START_PERCENT / 100);
+	{
+		Genetic heuristic(problemInstance);
+		heuristic.setUpperBound(upperBound);
+		bestSolution = heuristic.run(warmStart);
+		bestSolution.evaluate();		// Scored again in full, without the caches of the islands, before pruning on it
+
+		// The warm start is part of the search, its improvements are recorded with the time of the whole run
+		double offset_s = getSearchTime_s() - heuristic.getStatistics().time_s;
+		for (const pair<double, long>& improvement : heuristic.getStatistics().improvements)
+			statistics.improvements.emplace_back(offset_s + improvement.first, improvement.second);
+		statistics.generations = heuristic.getStatistics().generations;
+		statistics.evaluations = heuristic.getStatistics().evaluations;
+	}
+	incumbentObjective = bestSolution.getObjFunctionValue();
+
+	if (parameters.verbose)
+		fprintf_s(stdout, "Branch and bound starting from the incumbent with objective function value = %ld\n",
+			incumbentObjective.load());
+
+	long long searchStartTime = getCurrentTime_ms();
+	writer.start(parameters.outputFileName, parameters.sparseOutput);
+	if (reachedGoal(incumbentObjective, parameters))
+		stopToken.requestStop(StopToken::GOAL);
+	exploredNodes = 0;
+	openBound = LONG_MIN;
+
+	// The calling thread helps the workers while waiting for the search to complete
+	workers.reset(new WorkPool(std::max(parameters.nThreads, 2u) - 1));
+
+	Node root = { vector<uint64_t>(problemInstance.indexWords, 0), vector<uint64_t>(problemInstance.indexWords, 0) };
+	submitNode(std::move(root));
+	workers->wait(tasks);
+	workers.reset();
+
+	writer.stop();
+	statistics.evaluations += exploredNodes;
+	statistics.time_s = getSearchTime_s();
+
+	// A completed search proves the incumbent optimal, otherwise no solution beats the open nodes
+	searchBound = std::max(incumbentObjective.load(), openBound.load());
+
+	double elapsed_s = std::max(getCurrentTime_ms() - searchStartTime, 1LL) / 1000.0;
+	if (parameters.verbose)
+		fprintf_s(stdout, "Branch and bound explored %llu nodes in %.2f s (%.0f nodes/s): %s\n",
+			exploredNodes.load(), elapsed_s, exploredNodes.load() / elapsed_s,
+			stopToken.stopRequested() ? StopToken::getReasonName(stopToken.getReason()) : "optimality proven");
+
+	return bestSolution;
+}
+
+
+void BranchBound::submitNode(Node node)
+{
+	workers->submit([this, node]() { explore(node); }, &tasks);
+}
+
+
+void BranchBound::explore(Node root)
+{
+	const Instance& inst = problemInstance;
+	Scratch scratch = { vector<char>(inst.nConfigs), vector<double>(inst.nConfigs), vector<double>(inst.nConfigs), vector<int>(inst.nQueries),
+		vector<KnapsackItem>() };
+	scratch.items.reserve(inst.nQueries);
+	deque<Node> open;
+	unsigned long long nodes = 0;
+
+	open.push_back(std::move(root));
+	while (!open.empty() && !stopToken.shouldStop(nodes, BNB_CHECK_INTERVAL))
+	{
+		// Give away the shallowest open node, the largest subtree, whenever the other workers have nothing to do
+		if (open.size() > 1 && workers->getQueuedTasks() == 0)
+		{
+			submitNode(std::move(open.front()));
+			open.pop_front();
+		}
+
+		Node node = std::move(open.back());
+		open.pop_back();
+
+		double nodeBound;
+		long value;
+		int branchIndex;
+		if (!boundNode(node, scratch, nodeBound, value, branchIndex))
+			continue;
+
+		if (value > incumbentObjective.load(memory_order_relaxed))
+			updateIncumbent(scratch);
+
+		// Objective values are integers, the bound is fractional because of the shared costs
+		if (branchIndex < 0 || std::floor(nodeBound + 1e-6) <= incumbentObjective.load(memory_order_relaxed))
+			continue;
+
+		// Depth first, building the index before trying without it
+		uint64_t bit = (uint64_t)1 << (branchIndex % 64);
+		Node without = node;
+		without.excluded[branchIndex / 64] |= bit;
+		node.included[branchIndex / 64] |= bit;
+
+		open.push_back(std::move(without));
+		open.push_back(std::move(node));
+	}
+
+	// Nodes left by a stop: their bounds limit the solutions not explored
+	long bound = LONG_MIN;
+	for (const Node& node : open)
+	{
+		double nodeBound;
+		long value;
+		int branchIndex;
+		if (boundNode(node, scratch, nodeBound, value, branchIndex))
+			bound = std::max(bound, (long)std::floor(nodeBound + 1e-6));
+	}
+	long current = openBound.load();
+	while (bound > current && !openBound.compare_exchange_weak(current, bound));
+
+	exploredNodes += nodes;
+}
+
+
+bool BranchBound::boundNode(const Node& node, Scratch& scratch, double& nodeBound, long& value, int& branchIndex)
+{
+	const Instance& inst = problemInstance;
+	const int words = inst.indexWords;
+	const uint64_t* included = node.included.data();
+	const uint64_t* excluded = node.excluded.data();
+
+	long memory = sumOverBits(included, words, inst.indexesMemoryOccupation.data());
+	long cost = sumOverBits(included, words, inst.indexesFixedCost.data());
+	if (memory >= inst.M)
+		return false;
+
+	// Configurations avoiding the excluded indexes and fitting in the memory left,
+	// each charged with a share of the cost of its indexes not built yet
+	for (int c = 0; c < inst.nConfigs; c++)
+	{
+		const uint64_t* row = inst.getConfigIndexesRow(c);
+		bool compatible = true, built = true;
+		for (int w = 0; w < words; w++)
+		{
+			compatible = compatible && (row[w] & excluded[w]) == 0;
+			built = built && (row[w] & ~included[w]) == 0;
+		}
+
+		if (!compatible || memory + sumOverNewBits(row, included, words, inst.indexesMemoryOccupation.data()) >= inst.M)
+		{
+			scratch.status[c] = 0;
+			continue;
+		}
+
+		double pendingCost = 0, pendingMemory = 0;
+		for (int k : inst.indexesOfConfig(c))
+		{
+			if ((included[k / 64] & ((uint64_t)1 << (k % 64))) == 0)
+			{
+				pendingCost += (double)inst.indexesFixedCost[k] / std::max(inst.indexQueries[k], 1);
+				pendingMemory += (double)inst.indexesMemoryOccupation[k] / std::max(inst.indexQueries[k], 1);
+			}
+		}
+
+		scratch.status[c] = built ? 2 : 1;
+		scratch.pendingCost[c] = pendingCost;
+		scratch.pendingMemory[c] = pendingMemory;
+	}
+
+	// The memory left, valued at the Lagrange multiplier, bounds the extra memory the relaxed solution may use
+	double multiplier = upperBound != nullptr ? upperBound->getMultiplier() : 0;
+	double lagrangianBound = multiplier * (inst.M - 1 - memory);
+
+	// Best contribution of each query to the bounds, and best gain with the indexes already built
+	double bound = 0, largestGap = 0;
+	long gains = 0;
+	int branchConfig = -1;
+	scratch.items.clear();
+	for (int q = 0; q < inst.nQueries; q++)
+	{
+		double best = 0, bestLagrangian = 0, lightest = DBL_MAX;
+		int bestConfig = -1, served = 0, servingConfig = -1;
+
+		for (const GainEntry& entry : inst.configServingQueries(q))
+		{
+			if (scratch.status[entry.id] == 0)
+				continue;
+
+			double contribution = entry.gain - scratch.pendingCost[entry.id];
+			if (contribution > best)
+				best = contribution, bestConfig = entry.id;
+			if (contribution > 0)
+				lightest = std::min(lightest, scratch.pendingMemory[entry.id]);
+			bestLagrangian = std::max(bestLagrangian, contribution - multiplier * scratch.pendingMemory[entry.id]);
+			if (scratch.status[entry.id] == 2 && entry.gain > served)
+				served = entry.gain, servingConfig = entry.id;
+		}
+
+		bound += best;
+		lagrangianBound += bestLagrangian;
+		if (best > 0)
+			scratch.items.push_back({ best, lightest });
+		gains += served;
+		scratch.servingConfig[q] = servingConfig;
+
+		// Branch on the configuration promising the most over what is already built
+		if (bestConfig >= 0 && scratch.status[bestConfig] != 2 && best - served > largestGap)
+			largestGap = best - served, branchConfig = bestConfig;
+	}
+
+	// Every solution of the subtree serves each query with at most its best contribution, using at least its lightest
+	// shared memory, and the shares of the queries add up to at most the memory built: fill the memory left
+	// with the queries by decreasing value per unit of memory, splitting the last one (Dantzig bound)
+	std::sort(scratch.items.begin(), scratch.items.end(), [](const KnapsackItem& a, const KnapsackItem& b) {
+		return a.value * b.weight > b.value * a.weight;
+	});
+	double capacity = inst.M - 1 - memory, knapsackBound = 0;
+	for (const KnapsackItem& item : scratch.items)
+	{
+		if (item.weight <= capacity)
+		{
+			knapsackBound += item.value;
+			capacity -= item.weight;
+		}
+		else
+		{
+			knapsackBound += item.value * capacity / item.weight;
+			break;
+		}
+	}
+
+	bound = std::min(bound, knapsackBound);
+	nodeBound = (multiplier > 0 ? std::min(bound, lagrangianBound) : bound) - cost;
+	value = gains - cost;
+
+	branchIndex = -1;
+	if (branchConfig >= 0)
+	{
+		for (int k : inst.indexesOfConfig(branchConfig))
+		{
+			if ((included[k / 64] & ((uint64_t)1 << (k % 64))) == 0)
+			{
+				branchIndex = k;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void BranchBound::updateIncumbent(const Scratch& scratch)
+{
+	// Only the indexes of the serving configurations are built, the objective can only be higher than the node value
+	Solution candidate(problemInstance);
+	for (int q = 0; q < problemInstance.nQueries; q++)
+		candidate.selectedConfigurations[q] = (short)scratch.servingConfig[q];
+	candidate.evaluate();
+
+	lock_guard<mutex> lock(incumbentMutex);
+	if (candidate.getObjFunctionValue() <= incumbentObjective.load())
+		return;
+
+	bestSolution = candidate;
+	incumbentObjective = candidate.getObjFunctionValue();
+	recordImprovement(candidate.getObjFunctionValue());
+	writer.submit(make_shared<const Solution>(candidate));
+
+	if (parameters->verbose)
+		std::cout << "Found a new best solution with objective function value = "
+			<< candidate.getObjFunctionValue() << std::endl;
+
+	if (reachedGoal(candidate.getObjFunctionValue(), *parameters))
+		stopToken.requestStop(StopToken::GOAL);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+
+#include "algorithm.hpp"
+#include "workpool.hpp"
+#include "solutionwriter.hpp"
+
+
+#define BNB_WARM_START_PERCENT 10		// Share of the time limit given to the genetic algorithm, to find the initial incumbent
+#define BNB_CHECK_INTERVAL 64			// Nodes explored between two readings of the clock
+
+using namespace std;
+
+
+/*
+** BranchBound is an exact engine: it branches on building or excluding each index, and the configurations
+** are then free to serve the queries whenever all their indexes are built. Subtrees are explored depth first
+** by the workers of a WorkPool, which donate their shallowest open node whenever the pool runs out of tasks.
+** Nodes are pruned with an upper bound that shares the cost and memory of the indexes still to build among the queries
+** that could use them, considering only the configurations that fit in the memory left; the queries then fill
+** the memory left as a fractional knapsack. With an UpperBound available, the node bound also relaxes
+** the memory constraint with its Lagrange multiplier
+*/
+class BranchBound : public Algorithm
+{
+
+	// Subproblem of the search tree
+	struct Node {
+		vector<uint64_t> included;		// Indexes built in every solution of the subtree
+		vector<uint64_t> excluded;		// Indexes never built in the subtree
+	};
+
+	// Query in the knapsack relaxation: its best contribution, with the least shared memory of its configurations
+	struct KnapsackItem {
+		double value;
+		double weight;
+	};
+
+	// Working buffers of a worker thread
+	struct Scratch {
+		vector<char> status;			// Configurations incompatible with the node (0), compatible (1), with all indexes built (2)
+		vector<double> pendingCost;		// Shared cost of the indexes each configuration still needs
+		vector<double> pendingMemory;	// Shared memory of the same indexes, weighted in the Lagrangian bound
+		vector<int> servingConfig;		// Best configuration with all its indexes built, for each query
+		vector<KnapsackItem> items;
+	};
+
+private:
+
+	const Parameters* parameters;
+
+	unique_ptr<WorkPool> workers;
+	WorkPool::TaskGroup tasks;
+	atomic<unsigned long long> exploredNodes;
+	atomic<long> openBound;				// Highest bound of the nodes left open when the search is stopped
+
+	atomic<long> incumbentObjective;	// Objective of bestSolution, read without locks for pruning
+	mutex incumbentMutex;
+
+	SolutionWriter writer;
+
+
+public:
+
+	BranchBound(Instance& inst);
+	~BranchBound();
+
+	Solution run(const Parameters& parameters);
+
+private:
+
+	void explore(Node root);		// Depth-first search of a subtree, run as a WorkPool task
+	void submitNode(Node node);
+
+	// Computes the upper bound of the node and the value of its best solution using only the included indexes;
+	// returns false if the node is infeasible, otherwise sets the index to branch on (-1 for leaves)
+	bool boundNode(const Node& node, Scratch& scratch, double& nodeBound, long& value, int& branchIndex);
+
+	void updateIncumbent(const Scratch& scratch);
+
+};
@@ -0,0 +1,39 @@
+#include "evaluationcache.hpp"
+
+#include <algorithm>
+
+
+EvaluationCache::EvaluationCache(size_t capacity)
+	: entries(capacity),
+	mask(capacity - 1),
+	lookups(0),
+	hits(0)
+{
+	clear();
+}
+
+
+bool EvaluationCache::lookup(uint64_t hash, Entry& entry)
+{
+	const Entry& slot = entries[hash & mask];
+	lookups++;
+
+	if (!slot.used || slot.hash != hash)
+		return false;
+
+	entry = slot;
+	hits++;
+	return true;
+}
+
+
+void EvaluationCache::store(uint64_t hash, long totalGain, long totalCost, int memory)
+{
+	entries[hash & mask] = { hash, totalGain, totalCost, memory, true };
+}
+
+
+void EvaluationCache::clear()
+{
+	std::fill(entries.begin(), entries.end(), Entry{ 0, 0, 0, 0, false });
+}
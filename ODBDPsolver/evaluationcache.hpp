@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+
+#define EVALUATION_CACHE_SIZE 4096		// Entries, must be a power of 2
+
+using namespace std;
+
+
+/*
+** EvaluationCache is a fixed-size direct-mapped table from genome hashes to the scores of the evaluated solutions,
+** so that genomes already seen by a thread are not evaluated again. Newer entries overwrite older ones in the same slot,
+** and collisions of the 64-bit hashes are ignored. The cache is not thread-safe, each worker thread must own its own
+*/
+class EvaluationCache
+{
+
+public:
+
+	struct Entry {
+		uint64_t hash;
+		long totalGain;
+		long totalCost;
+		int memory;
+		bool used;
+	};
+
+private:
+
+	vector<Entry> entries;
+	size_t mask;
+
+	unsigned long long lookups;
+	unsigned long long hits;
+
+
+public:
+
+	EvaluationCache(size_t capacity = EVALUATION_CACHE_SIZE);
+
+	bool lookup(uint64_t hash, Entry& entry);
+	void store(uint64_t hash, long totalGain, long totalCost, int memory);
+	void clear();
+
+	unsigned long long getLookups() const { return lookups; }
+	unsigned long long getHits() const { return hits; }
+	unsigned long long getMisses() const { return lookups - hits; }		// Genomes evaluated in full
+
+};
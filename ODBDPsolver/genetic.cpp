@@ -1,15 +1,16 @@
 #include "genetic.hpp"
 
 #include <iostream>
+#include <algorithm>
 
 
 Genetic::Genetic(Instance& inst)
 	: Algorithm(inst), 
-	parameters(nullptr)
+	parameters(nullptr),
+	generationShare(0), evaluationShare(0),
+	bestObjective(bestSolution.getObjFunctionValue()),
+	bestSnapshot(make_shared<const Solution>(bestSolution))
 {
-	// Instantiate algorithm thread classes
-	for (int i = 1; i <= N_THREADS; i++)
-		threads.emplace_back(GeneticThread(*this, i));
 }
 
 Genetic::~Genetic()
@@ -20,51 +21,188 @@ Genetic::~Genetic()
 Solution Genetic::run(const Parameters& parameters)
 {
 	this->parameters = &parameters;
+	long long startingTime = getCurrentTime_ms();
+	startStatistics();
+	stopToken.setBudget(parameters.timeLimit);
+
+	writer.start(parameters.outputFileName, parameters.sparseOutput);
+	if (reachedGoal(bestObjective.load(), parameters))
+		stopToken.requestStop(StopToken::GOAL);
+
+	evaluationPool.reset(parameters.evaluationThreads > 0 ? new WorkPool(parameters.evaluationThreads) : nullptr);
+
+	// Instantiate algorithm thread classes
+	threads.clear();
+	for (unsigned int i = 1; i <= parameters.nThreads; i++)
+		threads.emplace_back(new GeneticThread(*this, i));
+
+	// Connect the islands in a ring, each one sending its emigrants to the next
+	std::vector<int> order(threads.size());
+	for (size_t i = 0; i < order.size(); i++)
+		order[i] = (int)i;
+	if (parameters.randomMigrationTopology)
+	{
+		RandomEngine engine(parameters.fixedSeed ? deriveSeed(parameters.seed, 0) : std::random_device{}());
+		std::shuffle(order.begin(), order.end(), engine);
+	}
+
+	migrationChannels.clear();
+	migrationTargets = std::vector<int>(threads.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		migrationChannels.emplace_back(new MigrationChannel(problemInstance.nQueries));
+		migrationTargets[order[i]] = order[(i + 1) % order.size()];
+	}
+
+	// Seeded runs migrate in lockstep, so the exchanges do not depend on the scheduling of the threads
+	migrationBarrier.reset(parameters.fixedSeed && threads.size() > 1 && parameters.migrationInterval > 0 ?
+		new MigrationBarrier((int)threads.size()) : nullptr);
+
+	// Split the budgets among the islands
+	generationShare = (parameters.generationBudget + threads.size() - 1) / threads.size();
+	evaluationShare = (parameters.evaluationBudget + threads.size() - 1) / threads.size();
+
+	// Report the counters of the islands while they run, if requested
+	if (parameters.verbose)
+	{
+		std::vector<const ThreadCounters*> threadCounters;
+		for (size_t i = 0; i < threads.size(); i++)
+			threadCounters.push_back(&threads[i]->getCounters());
+		reporter.start(threadCounters, parameters);
+	}
 
 	// Creating multiple threads to run the algorithm in parallel
-	std::thread workerThreads[N_THREADS];
-	for (int i = 0; i < N_THREADS; i++)
-		workerThreads[i] = std::thread(&Genetic::GeneticThread::run, threads[i]);
+	std::vector<std::thread> workerThreads;
+	workerThreads.reserve(threads.size());
+	for (size_t i = 0; i < threads.size(); i++)
+		workerThreads.emplace_back(&Genetic::GeneticThread::run, threads[i].get());
 
 	// Wait for each thread to terminate its job
-	for (int i = 0; i < N_THREADS; i++)
+	for (size_t i = 0; i < workerThreads.size(); i++)
 		workerThreads[i].join();
 
+	if (parameters.generationBudget > 0 || parameters.evaluationBudget > 0)
+		stopToken.requestStop(StopToken::BUDGET);		// Kept only if the islands did not stop for another reason
+
+	reporter.stop();
+	evaluationPool.reset();
+	migrationBarrier.reset();
+
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		statistics.generations += threads[i]->getCounters().get(ThreadCounters::GENERATIONS);
+		statistics.evaluations += threads[i]->getCounters().get(ThreadCounters::EVALUATIONS);
+	}
+	statistics.time_s = getSearchTime_s();
+
+	// Make sure the best solution has been written on the output file
+	writer.stop();
+	if (parameters.verbose)
+		reportStatistics(startingTime);
+
+	bestSolution = *atomic_load(&bestSnapshot);
 	return bestSolution;
 }
 
 
-void Genetic::updateBestSolution(const Solution& newBest)
+void Genetic::reportStatistics(long long startingTime) const
+{
+	fprintf_s(stdout, "%llu improving solutions written out of %llu found\n",
+		writer.getWrittenSolutions(), writer.getSubmittedSolutions());
+	if (stopToken.getReason() != StopToken::DEADLINE)
+		fprintf_s(stdout, "Search stopped after %.2f s, %s\n", (getCurrentTime_ms() - startingTime) / 1000.0,
+			StopToken::getReasonName(stopToken.getReason()));
+
+	// Report the throughput of the worker threads, to check the scaling
+	double elapsed_s = std::max(getCurrentTime_ms() - startingTime, 1LL) / 1000.0;
+	double phaseTime_s[N_PHASES] = { 0 };
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		const ThreadCounters& counters = threads[i]->getCounters();
+		fprintf_s(stdout, "Thread %d computed %llu generations (%.1f generations/s), %llu restarts, %llu local searches (%llu improving)\n",
+			(int)i + 1, counters.get(ThreadCounters::GENERATIONS), counters.get(ThreadCounters::GENERATIONS) / elapsed_s,
+			counters.get(ThreadCounters::RESTARTS), counters.get(ThreadCounters::LOCAL_SEARCHES),
+			counters.get(ThreadCounters::LOCAL_SEARCH_IMPROVEMENTS));
+		for (int p = 0; p < N_PHASES; p++)
+			phaseTime_s[p] += counters.getTime_s((Phase)p);
+	}
+	fprintf_s(stdout, "%d threads computed %llu generations (%.1f generations/s, %.0f evaluations/s)\n",
+		(int)threads.size(), statistics.generations, statistics.generations / elapsed_s, statistics.evaluations / elapsed_s);
+
+	// Where the time of the islands went
+	double threadTime_s = elapsed_s * threads.size();
+	fprintf_s(stdout, "Time of the threads: initialize %.1f%%, breed %.1f%%, full evaluations %.1f%%, select %.1f%%, local search %.1f%%\n",
+		100 * phaseTime_s[PHASE_INITIALIZE] / threadTime_s, 100 * phaseTime_s[PHASE_BREED] / threadTime_s, 100 * phaseTime_s[PHASE_FULL_EVALUATION] / threadTime_s,
+		100 * phaseTime_s[PHASE_SELECT] / threadTime_s, 100 * phaseTime_s[PHASE_LOCAL_SEARCH] / threadTime_s);
+
+	// Report the effectiveness of the evaluation caches
+	unsigned long long lookups = 0, hits = 0;
+	for (size_t i = 0; i < threads.size(); i++)
+	{
+		lookups += threads[i]->getEvaluationCache().getLookups();
+		hits += threads[i]->getEvaluationCache().getHits();
+	}
+	fprintf_s(stdout, "Evaluation caches: %llu hits out of %llu lookups (%.1f%%)\n",
+		hits, lookups, lookups > 0 ? 100.0 * hits / lookups : 0.0);
+}
+
+
+bool Genetic::updateBestSolution(const Solution& newBest)
 {
-	mtx.lock();		// LOCK
+	shared_ptr<const Solution> snapshot = publishBestSolution(newBest);
 
-	if (newBest.getObjFunctionValue() > bestSolution.getObjFunctionValue())
+	if (snapshot != nullptr)
 	{
-		bestSolution = newBest;
+		recordImprovement(snapshot->getObjFunctionValue());
 
-		std::cout << "Found a new best solution with objective function value = "
-			<< bestSolution.getObjFunctionValue() << std::endl;
+		if (parameters->verbose)
+			std::cout << "Found a new best solution with objective function value = "
+				<< newBest.getObjFunctionValue() << std::endl;
 
-		try 
-		{	// Write the new best solution on the output file
-			bestSolution.writeToFile(parameters->outputFileName);
-		}
-		catch (exception& e)
-		{
-			std::cerr << e.what() << std::endl;
-		}
+		// Hand the new best solution to the output file writer
+		writer.submit(snapshot);
+
+		// Ask all the islands to stop once the goal is reached
+		if (reachedGoal(snapshot->getObjFunctionValue(), *parameters))
+			stopToken.requestStop(StopToken::GOAL);
 	}
 
-	mtx.unlock();	// UNLOCK
+	return snapshot != nullptr;
+}
+
+
+shared_ptr<const Solution> Genetic::publishBestSolution(const Solution& newBest)
+{
+	long objective = newBest.getObjFunctionValue();
+	if (objective <= bestObjective.load())
+		return nullptr;
+
+	// Replace the snapshot only while it is still worse than the new solution,
+	// so concurrent improvements can never be overwritten by older ones
+	shared_ptr<const Solution> snapshot = make_shared<const Solution>(newBest);
+	shared_ptr<const Solution> current = atomic_load(&bestSnapshot);
+	do {
+		if (current->getObjFunctionValue() >= objective)
+			return nullptr;
+	} while (!atomic_compare_exchange_weak(&bestSnapshot, &current, snapshot));
+
+	// Raise the published objective value to the new one, unless a better one has already been stored
+	long published = bestObjective.load();
+	while (published < objective && !bestObjective.compare_exchange_weak(published, objective));
+
+	return snapshot;
 }
 
 
 
 Genetic::GeneticThread::GeneticThread(Genetic& caller, int tID)
-	: algorithm(caller), threadID(tID),
+	: threadID(tID), algorithm(caller),
 	localBestSolution(Solution(algorithm.problemInstance)),
-	population(std::multiset<Solution*, solution_comparator>()),
-	parents(), offsprings(), generation_counter(0)
+	pool(algorithm.problemInstance, 2 * POPULATION_SIZE),
+	parents(), offsprings(),
+	population(), populationSize(0),
+	mutationSkipScale(1.0 / std::log1p(-1.0 / algorithm.problemInstance.nQueries)),
+	generation_counter(0)
 {
 }
 
@@ -76,29 +214,53 @@ Genetic::GeneticThread::~GeneticThread()
 void Genetic::GeneticThread::run()
 {
 	unsigned int last_update;
-	long long startingTime = getCurrentTime_ms();
 	LocalSearch refiner(algorithm.problemInstance);
+	refiner.setEvaluationCache(&evaluationCache);
 
 	// INITIALIZATION
-	start:	fprintf_s(stdout, "Thread %d is (re)starting the algorithm...\n", threadID);
+	start:
+	if (algorithm.parameters->verbose)
+		fprintf_s(stdout, "Thread %d is (re)starting the algorithm...\n", threadID);
 
-	random_number.seed(std::random_device{}());
-	localBestSolution = Solution(algorithm.problemInstance);
+	seedRandomNumbers();
+	localBestSolution.reset();
 
 	generation_counter = 0, last_update = 0;
-	long long currentTime = getCurrentTime_ms();
 
 	// Randomly choosing one of the 2 avaiable initializers
-	initializePopulation(random_number() % 2);
+	initializePopulation(randomBelow(random_number, 2));
 
-	// REPEAT UNTIL THERE'S COMPUTATIONAL TIME LEFT (OR ALGORITHM RESTART)
-	while (currentTime - startingTime < algorithm.parameters->timeLimit)
+	// REPEAT UNTIL THE SEARCH IS STOPPED (OR ALGORITHM RESTART)
+	// a generation is long enough to read the clock every time
+	while (!algorithm.stopToken.checkDeadline())
 	{
+		if (exhaustedBudget())
+			break;
+
+		// Periodically exchange individuals with the other islands: in lockstep, over the generations
+		// of all the restarts, when seeded; otherwise never in the first generation after a (re)start
+		if (algorithm.migrationBarrier != nullptr)
+		{
+			unsigned long long generations = counters.get(ThreadCounters::GENERATIONS);
+			if (generations % algorithm.parameters->migrationInterval == 0)
+				migrate(generations / algorithm.parameters->migrationInterval);
+		}
+		else if (algorithm.parameters->migrationInterval > 0 && algorithm.threads.size() > 1 &&
+			generation_counter > 0 && generation_counter % algorithm.parameters->migrationInterval == 0)
+		{
+			migrate();
+		}
+
 		// Generate offsprings
+		long long phaseStart = ThreadCounters::now_ns();
 		breedPopulation();
+		long long phaseEnd = ThreadCounters::now_ns();
+		counters.addTime(PHASE_BREED, phaseEnd - phaseStart);
 
 		// Replace the current population with the best offsprings (and parents)
-		if (replacePopulationByFitness())
+		bool improved = replacePopulationByFitness();
+		counters.addTime(PHASE_SELECT, ThreadCounters::now_ns() - phaseEnd);
+		if (improved)
 		{
 			last_update = generation_counter;
 		}
@@ -106,7 +268,9 @@ void Genetic::GeneticThread::run()
 		// Periodically run a local search to specialize the population
 		if (generation_counter - last_update == 50)
 		{
+			phaseStart = ThreadCounters::now_ns();
 			localSearch(refiner);
+			counters.addTime(PHASE_LOCAL_SEARCH, ThreadCounters::now_ns() - phaseStart);
 		}
 
 		// Multi-start technique in case the algorithm gets stuck in a local optimum
@@ -115,80 +279,112 @@ void Genetic::GeneticThread::run()
 			if (last_update > MAX_GENERATIONS_BEFORE_RESTART)
 				MAX_GENERATIONS_BEFORE_RESTART = last_update;
 
-			// Empty the population set, delete all existing solution objects
-			for (auto it = population.begin(); it != population.end(); it++)
-				delete* it;
-			population.clear();
+			// Empty the population, recycle all existing solution objects
+			clearPopulation();
+			counters.add(ThreadCounters::RESTARTS);
 
 			goto start;
 		}
 
 		// Check if the current generation has produced a solution better than the previous best
-		if (localBestSolution.getObjFunctionValue() > algorithm.bestSolution.getObjFunctionValue())
+		if (localBestSolution.getObjFunctionValue() > algorithm.bestObjective.load(memory_order_relaxed))
 		{
-			algorithm.updateBestSolution(localBestSolution);
+			if (algorithm.updateBestSolution(localBestSolution))
+				counters.add(ThreadCounters::IMPROVEMENTS);
 		}
 
-		currentTime = getCurrentTime_ms();		// Update timestamp and generation number
-		generation_counter++;
+		generation_counter++;		// Update generation number
+		counters.add(ThreadCounters::GENERATIONS);
+		counters.set(ThreadCounters::ACQUIRED_SOLUTIONS, pool.getAcquisitions());
 	}
+
+	// Let the other islands migrate without this one
+	if (algorithm.migrationBarrier != nullptr)
+		algorithm.migrationBarrier->leave(threadID - 1);
+}
+
+
+void Genetic::GeneticThread::seedRandomNumbers()
+{
+	if (!algorithm.parameters->fixedSeed)
+	{
+		random_number.seed(std::random_device{}());
+		return;
+	}
+
+	// A stream for each island, and one for each of its restarts
+	random_number.seed(deriveSeed(deriveSeed(algorithm.parameters->seed, threadID), counters.get(ThreadCounters::RESTARTS)));
+}
+
+
+bool Genetic::GeneticThread::exhaustedBudget() const
+{
+	return (algorithm.generationShare > 0 && counters.get(ThreadCounters::GENERATIONS) >= algorithm.generationShare) ||
+		(algorithm.evaluationShare > 0 && counters.get(ThreadCounters::EVALUATIONS) >= algorithm.evaluationShare);
 }
 
 
 // Greedy generations and evaluation of the starting population set
 void Genetic::GeneticThread::initializePopulation(int type)
 {
+	long long phaseStart = ThreadCounters::now_ns();
+
 	// The first solution is always kept with the default configuration
-	parents[0] = new Solution(algorithm.problemInstance);
+	parents[0] = pool.acquire();
+	parents[0]->reset();
 
 	switch (type)	// Multiple initializers are available
 	{
 	case 0:
 	{
-		// Vector with the set of configurations already used by a solution
-		std::vector<int> usedConfigs;			
-		usedConfigs.reserve(algorithm.problemInstance.nConfigs);
+		// Times each configuration has been used by a solution
+		std::vector<int> usedConfigs(algorithm.problemInstance.nConfigs, 0);
 
 		for (int n = 1; n < POPULATION_SIZE; n++)			// P-1 solutions are initialized with the greedy algorithm
 		{
-			usedConfigs.clear();
-			parents[n] = new Solution(algorithm.problemInstance);
+			std::fill(usedConfigs.begin(), usedConfigs.end(), 0);
+			parents[n] = pool.acquire();
+			parents[n]->reset();
 			
 			// Fill the queries in a random order
 			for (int i = 0; i < 2 * algorithm.problemInstance.nQueries; i++) 
 			{
-				int query = random_number() % algorithm.problemInstance.nQueries;			// Select a random query
-				parents[n]->selectedConfigurations[query] = maxGainGivenQuery(query);		// Get the best configuration for that query
-				usedConfigs.emplace_back(parents[n]->selectedConfigurations[query]);		// Keep track of the configurations used
+				int query = randomBelow(random_number, algorithm.problemInstance.nQueries);			// Select a random query
+				int best = maxGainGivenQuery(query);
+				if (best < 0)		// No configuration serves the query (all removed by the presolve)
+					continue;
+
+				parents[n]->setConfiguration(query, best);									// Get the best configuration for that query
+				usedConfigs[best]++;														// Keep track of the configurations used
 
-				if (parents[n]->evaluateMemory() > algorithm.problemInstance.M)		// Remove the configuration if it raises the memory cost > M
+				if (parents[n]->getMemoryCost() > algorithm.problemInstance.M)		// Remove the configuration if it raises the memory cost > M
 				{
-					usedConfigs.pop_back();										
-					if (i % 3 == 2) parents[n]->selectedConfigurations[query] = getHighestGainConfiguration(usedConfigs, query);
-					if (i % 3 == 1) parents[n]->selectedConfigurations[query] = getRandomConfiguration(usedConfigs, query);
-					else parents[n]->selectedConfigurations[query] = -1;		// Backtrack, do not serve this query
+					usedConfigs[best]--;
+					if (i % 3 == 2) parents[n]->setConfiguration(query, getHighestGainConfiguration(usedConfigs, query));
+					if (i % 3 == 1) parents[n]->setConfiguration(query, getRandomConfiguration(usedConfigs, query));
+					else parents[n]->setConfiguration(query, -1);		// Backtrack, do not serve this query
 				}
 			}
 
 			// Fill the rest of the queries in order, using the same technique
 			for (int i = 0; i < algorithm.problemInstance.nQueries; i++) 
 			{
-				if (parents[n]->selectedConfigurations[i] < 0) 
+				int best = maxGainGivenQuery(i);
+				if (parents[n]->selectedConfigurations[i] < 0 && best >= 0) 
 				{
-					parents[n]->selectedConfigurations[i] = maxGainGivenQuery(i);
-					usedConfigs.emplace_back(parents[n]->selectedConfigurations[i]);
+					parents[n]->setConfiguration(i, best);
+					usedConfigs[best]++;
 
-					if (parents[n]->evaluateMemory() > algorithm.problemInstance.M) 
+					if (parents[n]->getMemoryCost() > algorithm.problemInstance.M) 
 					{
-						usedConfigs.pop_back();
-						if (i % 3 == 2) parents[n]->selectedConfigurations[i] = getHighestGainConfiguration(usedConfigs, i);
-						if (i % 3 == 1) parents[n]->selectedConfigurations[i] = getRandomConfiguration(usedConfigs, i);
-						else parents[n]->selectedConfigurations[i] = -1;
+						usedConfigs[best]--;
+						if (i % 3 == 2) parents[n]->setConfiguration(i, getHighestGainConfiguration(usedConfigs, i));
+						if (i % 3 == 1) parents[n]->setConfiguration(i, getRandomConfiguration(usedConfigs, i));
+						else parents[n]->setConfiguration(i, -1);
 					}
 				}
 			}
 
-			parents[n]->evaluate();		// Evaluation of the new solution
 		}
 
 		break;
@@ -196,50 +392,44 @@ void Genetic::GeneticThread::initializePopulation(int type)
 
 	case 1:
 	{
-		std::vector<int> b = std::vector<int>(algorithm.problemInstance.nIndexes, 0);
+		const Instance& inst = algorithm.problemInstance;
+		std::vector<uint64_t> b = std::vector<uint64_t>(inst.indexWords, 0);
 
 		for (int n = 1; n < POPULATION_SIZE; n++) 
 		{
 			std::fill(b.begin(), b.end(), 0);
-			parents[n] = new Solution(algorithm.problemInstance);
+			parents[n] = pool.acquire();
+			parents[n]->reset();
 
-			// Examine each query in order
-			for (int i = 0, mem = 0; i < algorithm.problemInstance.nQueries; i++)
+			// Examine each query in order, skipping those that no configuration serves
+			for (int i = 0, mem = 0; i < inst.nQueries; i++)
 			{
-				if (parents[n]->selectedConfigurations[i] < 0) 
+				if (parents[n]->selectedConfigurations[i] < 0 && inst.configServingQueries(i).size() > 0) 
 				{
-					int delta_mem = 0;
-
 					// Get a random configuration that serves the current query
-					int conf = algorithm.problemInstance.configServingQueries[i]
-						[random_number() % algorithm.problemInstance.configServingQueries[i].size()];
+					int conf = inst.configServingQueries(i)
+						[randomBelow(random_number, (uint32_t)inst.configServingQueries(i).size())].id;
 
 					// Compute the additional memory cost required for activating that configuration
-					for (int j = 0; j < algorithm.problemInstance.nIndexes; j++) {
-						if (algorithm.problemInstance.configIndexesMatrix[conf][j] && b[j] == 0)
-							delta_mem += algorithm.problemInstance.indexesMemoryOccupation[j];
-					}
+					int delta_mem = (int)sumOverNewBits(inst.getConfigIndexesRow(conf), b.data(), inst.indexWords, inst.indexesMemoryOccupation.data());
 
 					mem += delta_mem;	// Update solution memory cost
 
-					if (mem < algorithm.problemInstance.M)		// If the solution is still feasible...
+					if (mem < inst.M)		// If the solution is still feasible...
 					{
 						// ... activate the indexes required by that configuration
-						for (int j = 0; j < algorithm.problemInstance.nIndexes; j++) {
-							if (algorithm.problemInstance.configIndexesMatrix[conf][j])
-								b[j] = 1;
-						}
+						orBits(b.data(), inst.getConfigIndexesRow(conf), inst.indexWords);
+
 						// Use this configuration for all unserved queries that benefit from it
-						for (int k = 0; k < algorithm.problemInstance.queriesWithGain[conf].size(); k++) {
-							if (parents[n]->selectedConfigurations[algorithm.problemInstance.queriesWithGain[conf][k]] == -1)
-								parents[n]->selectedConfigurations[algorithm.problemInstance.queriesWithGain[conf][k]] = conf;
+						for (const GainEntry& entry : inst.queriesWithGain(conf)) {
+							if (parents[n]->selectedConfigurations[entry.id] == -1)
+								parents[n]->selectedConfigurations[entry.id] = conf;
 						}
 					}
 					else mem -= delta_mem;		//  Backtrack, do not use this configuration for this query
 				}
 			}
 
-			parents[n]->evaluate();		// Evaluation of the new solution
 		}
 
 		break;
@@ -248,15 +438,24 @@ void Genetic::GeneticThread::initializePopulation(int type)
 	default:
 	{
 		// Initialize the entire population with default solutions
-		for (int k = 1; k < POPULATION_SIZE; k++)
-			parents[k] = new Solution(algorithm.problemInstance);
+		for (int k = 1; k < POPULATION_SIZE; k++) {
+			parents[k] = pool.acquire();
+			parents[k]->reset();
+		}
 		break;
 	}
 	}
 
-	// Initialization of the starting population set
-	population.clear();
-	population.insert(parents, parents + POPULATION_SIZE);
+	// Evaluation of the new solutions, all in one batch; only the genomes missing the cache are scored
+	long long phaseEnd = ThreadCounters::now_ns();
+	counters.addTime(PHASE_INITIALIZE, phaseEnd - phaseStart);
+	unsigned long long misses = evaluationCache.getMisses();
+	Solution::evaluateBatch(parents + 1, POPULATION_SIZE - 1, algorithm.evaluationPool.get(), &evaluationCache);
+	counters.addTime(PHASE_FULL_EVALUATION, ThreadCounters::now_ns() - phaseEnd);
+	counters.add(ThreadCounters::EVALUATIONS, evaluationCache.getMisses() - misses);
+
+	// Initialization of the starting population
+	setPopulation(parents, POPULATION_SIZE);
 
 	checkImprovingSolutions(parents, POPULATION_SIZE);
 }
@@ -265,26 +464,23 @@ void Genetic::GeneticThread::initializePopulation(int type)
 void Genetic::GeneticThread::breedPopulation()
 {
 	// Select the best POPULATION_SIZE elements to use as parents
-	auto it = population.begin();
-	for (int i = 0; it != population.end(); ++it, ++i)
-	{
-		if (i < POPULATION_SIZE)
-			parents[i] = *it;
-		else delete *it;
-	}
+	selectSurvivors();
+	for (int i = 0; i < populationSize; i++)
+		parents[i] = population[i].individual;
 
 	// Duplicate parents before breeding, to create offsprings
 	for (int i = 0; i < POPULATION_SIZE; i++) {
-		offsprings[i] = new Solution(*parents[i]);
+		offsprings[i] = pool.acquire();
+		*offsprings[i] = *parents[i];
 	}
-	
+
 	// Randomize the number of crossover points
-	int N = (random_number() % 4) + MIN_CROSSOVER_POINTS;
+	int N = randomBelow(random_number, 4) + MIN_CROSSOVER_POINTS;
 
 	// Apply the crossover operator on pairs of solutions
 	for (int i = 0; i < POPULATION_SIZE / 2; i++) {
-		int A = random_number() % POPULATION_SIZE;
-		int B = random_number() % POPULATION_SIZE;
+		int A = randomBelow(random_number, POPULATION_SIZE);
+		int B = randomBelow(random_number, POPULATION_SIZE);
 		crossover(offsprings[A], offsprings[B], N);
 	}
 
@@ -292,6 +488,12 @@ void Genetic::GeneticThread::breedPopulation()
 	for (int i = 0; i < POPULATION_SIZE ; i++) {
 		mutate(offsprings[i]);
 	}
+
+	// The offsprings whose genome changed have been scored again, by the incremental updates of their genes
+	int rescored = 0;
+	for (int i = 0; i < POPULATION_SIZE; i++)
+		rescored += (offsprings[i]->getGenomeHash() != parents[i]->getGenomeHash()) ? 1 : 0;
+	counters.add(ThreadCounters::EVALUATIONS, rescored);
 }
 
 
@@ -300,15 +502,21 @@ void Genetic::GeneticThread::crossover(Solution* itemA, Solution* itemB, int N)
 	// N-point crossover implementation: 
 	// the solution vector is split into N sections of size M
 	int length = algorithm.problemInstance.nQueries;
-	int M = length / N;
+	int M = std::max(length / N, 1);		// At least one gene per section, for instances with very few queries
 
 	// Odd chromosomes are swapped between the 2 solutions
 	for (int i = 0; i < length; i += 2 * M)
 	{
 		for (int j = 0; j < M && (j + i) < length; j++)
 		{
-			// Swap the genes inside the selected chromosomes
-			swap(itemA->selectedConfigurations[i + j], itemB->selectedConfigurations[i + j]);
+			// Swap the genes inside the selected chromosomes, updating both solutions incrementally
+			short geneA = itemA->selectedConfigurations[i + j];
+			short geneB = itemB->selectedConfigurations[i + j];
+			if (geneA != geneB)
+			{
+				itemA->setConfiguration(i + j, geneB);
+				itemB->setConfiguration(i + j, geneA);
+			}
 		}
 	}
 }
@@ -316,34 +524,29 @@ void Genetic::GeneticThread::crossover(Solution* itemA, Solution* itemB, int N)
 
 void Genetic::GeneticThread::mutate(Solution* sol)
 {
-	// Iterate over the genes in the solution
-	for (int i = 0; i < algorithm.problemInstance.nQueries; i++)
+	// Mutation of each gene occurs with a probability of 1/#genes: jump from a mutated gene to the next one,
+	// skipping the unchanged genes in between with a geometric draw
+	for (int i = randomGeometric(random_number, mutationSkipScale); i < algorithm.problemInstance.nQueries;
+		i += 1 + randomGeometric(random_number, mutationSkipScale))
 	{
-		// Mutation of the gene occurs with a probability of 1/#genes
-		if (random_number() % algorithm.problemInstance.nQueries == 0)
-		{
-			// Chance of choosing another config that servers this query
-			if (random_number() % 100 < MUTATION_PROBABILITY_NONZERO) {
-				short int randomConfigIndex = random_number() % algorithm.problemInstance.configServingQueries[i].size();
-				sol->selectedConfigurations[i] = algorithm.problemInstance.configServingQueries[i][randomConfigIndex];
-			}
-			// Chance of resetting this query to being served by "no configuration"
-			else sol->selectedConfigurations[i] = -1;
+		// Chance of choosing another config that servers this query
+		if (randomBelow(random_number, 100) < MUTATION_PROBABILITY_NONZERO && algorithm.problemInstance.configServingQueries(i).size() > 0) {
+			short int randomConfigIndex = randomBelow(random_number, (uint32_t)algorithm.problemInstance.configServingQueries(i).size());
+			sol->setConfiguration(i, algorithm.problemInstance.configServingQueries(i)[randomConfigIndex].id);
 		}
+		// Chance of resetting this query to being served by "no configuration"
+		else sol->setConfiguration(i, -1);
 	}
 }
 
 
 bool Genetic::GeneticThread::replacePopulationByFitness()
 {
-	// Evaluate the generated offsprings one by one
-	for (int i = 0; i < POPULATION_SIZE; i++)
-		offsprings[i]->evaluate();
+	// Offsprings are already evaluated, crossover and mutation
+	// keep their scores up to date through incremental gene updates
 
 	// Replace the old population with the current parents and offsprings
-	population.clear();
-	population.insert(parents, parents + POPULATION_SIZE);
-	population.insert(offsprings, offsprings + POPULATION_SIZE);
+	setPopulation(parents, POPULATION_SIZE, offsprings, POPULATION_SIZE);
 
 	return checkImprovingSolutions(offsprings, POPULATION_SIZE);
 }
@@ -364,7 +567,7 @@ bool Genetic::GeneticThread::checkImprovingSolutions(Solution* candidates[], int
 
 	if (best != &localBestSolution)
 	{
-		localBestSolution = Solution(*best);		// Update the best solution found in the current run
+		localBestSolution = *best;		// Update the best solution found in the current run
 		return true;
 	}
 	
@@ -374,25 +577,107 @@ bool Genetic::GeneticThread::checkImprovingSolutions(Solution* candidates[], int
 
 void Genetic::GeneticThread::localSearch(LocalSearch& refiner)
 {
-	auto it = population.begin();
-	std::vector<Solution*> solutions;
-	solutions.reserve(POPULATION_SIZE);
+	selectSurvivors();
 
-	for (int i = 0; it != population.end(); ++it, i++)
+	// The improved solutions are evaluated through the cache of the thread
+	unsigned long long misses = evaluationCache.getMisses();
+	for (int i = 0; i < populationSize; i++)
 	{
-		if (i < POPULATION_SIZE)
-		{
-			// Run local-search improvement on each solution
-			refiner.setStartingPoint(**it);
-			solutions.push_back(new Solution(refiner.run(*algorithm.parameters)));
-		}
-		delete* it;
+		// Run local-search improvement on each solution, replacing
+		// the individual with its improved counterpart in place
+		refiner.setStartingPoint(*population[i].individual);
+		long before = population[i].individual->getObjFunctionValue();
+		*population[i].individual = refiner.run(*algorithm.parameters);
+		parents[i] = population[i].individual;
+
+		counters.add(ThreadCounters::LOCAL_SEARCH_IMPROVEMENTS, population[i].individual->getObjFunctionValue() > before ? 1 : 0);
+	}
+	counters.add(ThreadCounters::LOCAL_SEARCHES, populationSize);
+	counters.add(ThreadCounters::EVALUATIONS, evaluationCache.getMisses() - misses);
+
+	// Rebuild the population with the improved individuals
+	setPopulation(parents, populationSize);
+}
+
+
+void Genetic::GeneticThread::migrate(unsigned long long round)
+{
+	MigrationChannel& outbound = *algorithm.migrationChannels[algorithm.migrationTargets[threadID - 1]];
+	MigrationChannel& inbound = *algorithm.migrationChannels[threadID - 1];
+
+	selectSurvivors();
+
+	// Send copies of the elite individuals to the next island, dropping them if its channel is full
+	for (int i = 0; i < MIGRATION_ELITES && i < populationSize; i++)
+		outbound.push(population[i].individual->selectedConfigurations.data());
+
+	// Seeded runs wait for all the emigrants before receiving, and for all the islands to receive before going on
+	if (algorithm.migrationBarrier != nullptr)
+		algorithm.migrationBarrier->arrive(threadID - 1, 2 * round + 1);
+
+	// Replace the worst individuals with the immigrants waiting in the inbound channel, if any
+	int immigrants = 0;
+	for (int i = populationSize - 1; i >= MIGRATION_ELITES && inbound.pop(population[i].individual->selectedConfigurations.data()); i--, immigrants++)
+	{
+		offsprings[immigrants] = population[i].individual;
+	}
+
+	if (algorithm.migrationBarrier != nullptr)
+		algorithm.migrationBarrier->arrive(threadID - 1, 2 * round + 2);
+
+	if (immigrants > 0)
+	{
+		long long phaseStart = ThreadCounters::now_ns();
+		unsigned long long misses = evaluationCache.getMisses();
+		Solution::evaluateBatch(offsprings, immigrants, algorithm.evaluationPool.get(), &evaluationCache);
+		counters.addTime(PHASE_FULL_EVALUATION, ThreadCounters::now_ns() - phaseStart);
+		counters.add(ThreadCounters::EVALUATIONS, evaluationCache.getMisses() - misses);
+		for (int i = populationSize - immigrants; i < populationSize; i++)
+			population[i].fitness = population[i].individual->getFitnessValue();
+
+		std::sort(population, population + populationSize, entry_comparator());
+		checkImprovingSolutions(offsprings, immigrants);
+	}
+}
+
+
+void Genetic::GeneticThread::setPopulation(Solution* first[], int firstSize, Solution* second[], int secondSize)
+{
+	populationSize = 0;
+
+	for (int i = 0; i < firstSize; i++, populationSize++)
+		population[populationSize] = { first[i]->getFitnessValue(), populationSize, first[i] };
+
+	for (int i = 0; i < secondSize; i++, populationSize++)
+		population[populationSize] = { second[i]->getFitnessValue(), populationSize, second[i] };
+}
+
+
+void Genetic::GeneticThread::selectSurvivors()
+{
+	// Partition the population around the POPULATION_SIZE-th best entry in linear time,
+	// recycling the individuals that did not survive
+	if (populationSize > POPULATION_SIZE)
+	{
+		std::nth_element(population, population + POPULATION_SIZE, population + populationSize, entry_comparator());
+
+		for (int i = POPULATION_SIZE; i < populationSize; i++)
+			pool.release(population[i].individual);
+
+		populationSize = POPULATION_SIZE;
 	}
 
-	// Replace the previous individuals in the population
-	// with their improved counterparts
-	population.clear();
-	population.insert(solutions.begin(), solutions.end());
+	// Rank the survivors by fitness
+	std::sort(population, population + populationSize, entry_comparator());
+}
+
+
+void Genetic::GeneticThread::clearPopulation()
+{
+	for (int i = 0; i < populationSize; i++)
+		pool.release(population[i].individual);
+
+	populationSize = 0;
 }
 
 
@@ -401,50 +686,38 @@ void Genetic::GeneticThread::localSearch(LocalSearch& refiner)
 
 
 // Pick a random configuration (that provides a gain > 0) out of those already used by a solution
-int Genetic::GeneticThread::getRandomConfiguration(std::vector<int>& usedConfigs, int queryIndex)
+int Genetic::GeneticThread::getRandomConfiguration(const std::vector<int>& usedConfigs, int queryIndex)
 {
-	for (int i = 0; i < usedConfigs.size(); i++) {
-		int randomConfig = usedConfigs[random_number() % usedConfigs.size()];
-		if (algorithm.problemInstance.configQueriesGain[randomConfig][queryIndex] > 0) {
-			return randomConfig;
+	// One pass over the configurations serving the query, each used one replacing the pick with probability 1/(used ones so far)
+	int randomConfig = -1;
+	uint32_t candidates = 0;
+	for (const GainEntry& entry : algorithm.problemInstance.configServingQueries(queryIndex)) {
+		if (entry.gain > 0 && usedConfigs[entry.id] > 0 && randomBelow(random_number, ++candidates) == 0) {
+			randomConfig = entry.id;
 		}
 	}
 
-	return -1;	// if none, backtrack
+	return randomConfig;	// if none, backtrack
 }
 
 
 // Given the configurations already used by a solution, 
 // pick one that gives the highest gain to a specific query
-int Genetic::GeneticThread::getHighestGainConfiguration(std::vector<int>& usedConfigs, int queryIndex)
+int Genetic::GeneticThread::getHighestGainConfiguration(const std::vector<int>& usedConfigs, int queryIndex)
 {
-	int maxConfig = -1;
-
-	for (int i = 0, maxGain = 0; i < usedConfigs.size(); i++) {
-		if (algorithm.problemInstance.configQueriesGain[usedConfigs[i]][queryIndex] > maxGain) 
-		{
-			maxGain = algorithm.problemInstance.configQueriesGain[usedConfigs[i]][queryIndex];
-			maxConfig = usedConfigs[i];
-		}
+	// The column sorted by decreasing gain: the first used configuration is the best one
+	for (const GainEntry& entry : algorithm.problemInstance.configsByGain(queryIndex)) {
+		if (entry.gain > 0 && usedConfigs[entry.id] > 0)
+			return entry.id;
 	}
 
-	return maxConfig;
+	return -1;
 }
 
 
 // Returns the index of the configuration providing the maximum gain for a given query
 int Genetic::GeneticThread::maxGainGivenQuery(int queryIndex)
 {
-	int maxConfig = -1;
-	const Instance& inst = algorithm.problemInstance;
-	
-	for (int i = 0, maxGain = 0; i < inst.configServingQueries[queryIndex].size(); i++) {
-		if (inst.configQueriesGain[inst.configServingQueries[queryIndex][i]][queryIndex] > maxGain) 
-		{
-			maxGain = inst.configQueriesGain[inst.configServingQueries[queryIndex][i]][queryIndex];
-			maxConfig = inst.configServingQueries[queryIndex][i];
-		}
-	}
-
-	return maxConfig;
+	// Precomputed at load time, the query columns are sorted by decreasing gain
+	return algorithm.problemInstance.bestConfigForQuery(queryIndex);
 }
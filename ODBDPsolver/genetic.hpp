@@ -1,19 +1,26 @@
 #pragma once
 
-#include <set>
 #include <vector> 
 #include <thread>  
 #include <mutex>
-#include <random>
+#include <atomic>
+#include <memory>
 
 #include "algorithm.hpp"
 #include "localsearch.hpp"
+#include "solutionpool.hpp"
+#include "migration.hpp"
+#include "solutionwriter.hpp"
+#include "workpool.hpp"
+#include "evaluationcache.hpp"
+#include "threadstats.hpp"
+#include "random.hpp"
 
 
 #define MIN_CROSSOVER_POINTS 2
 #define POPULATION_SIZE 100
 #define MUTATION_PROBABILITY_NONZERO 90
-#define N_THREADS 2
+#define MIGRATION_ELITES 2
 
 using namespace std;
 
@@ -25,11 +32,18 @@ class Genetic : public Algorithm
 	class GeneticThread
 	{
 
-		// Comparator for Solution objects, to use in the population sorted set
-		struct solution_comparator {
-			bool operator() (const Solution* lhs, const Solution* rhs) const
+		// Record of an individual in the population array
+		struct PopulationEntry {
+			long fitness;
+			int order;				// Insertion order, used to break ties between equal fitness values
+			Solution* individual;
+		};
+
+		// Ranking of population entries: higher fitness first, then older entries first
+		struct entry_comparator {
+			bool operator() (const PopulationEntry& lhs, const PopulationEntry& rhs) const
 			{
-				return lhs->getFitnessValue() > rhs->getFitnessValue();
+				return lhs.fitness > rhs.fitness || (lhs.fitness == rhs.fitness && lhs.order < rhs.order);
 			}
 		};
 
@@ -38,13 +52,20 @@ class Genetic : public Algorithm
 		const int threadID;
 		Genetic& algorithm;
 		Solution localBestSolution;
+		SolutionPool pool;
 		Solution* parents[POPULATION_SIZE] = { nullptr };
 		Solution* offsprings[POPULATION_SIZE] = { nullptr };
-		std::multiset<Solution*, solution_comparator> population;
-		std::mt19937 random_number;
+		PopulationEntry population[2 * POPULATION_SIZE];
+		int populationSize;
+		RandomEngine random_number;
+		double mutationSkipScale;				// Of the geometric sampling of the genes to mutate, each one with probability 1/#genes
 
 		unsigned int generation_counter;
 		unsigned int MAX_GENERATIONS_BEFORE_RESTART = 1000;
+		EvaluationCache evaluationCache;			// Scores of the genomes recently evaluated by the thread
+		ThreadCounters counters;					// Across all the restarts, read live by the StatsReporter
+
+		friend class MicroBenchmark;				// Times the genetic operators one by one
 
 
 	public:
@@ -53,6 +74,8 @@ class Genetic : public Algorithm
 		~GeneticThread();
 
 		void run();		// Thread entry point
+		const ThreadCounters& getCounters() const { return counters; }
+		const EvaluationCache& getEvaluationCache() const { return evaluationCache; }
 
 	private:
 
@@ -64,10 +87,18 @@ class Genetic : public Algorithm
 		bool replacePopulationByFitness();
 		bool checkImprovingSolutions(Solution* candidates[], int size);
 		void localSearch(LocalSearch& refiner);
+		void migrate(unsigned long long round = 0);
+		bool exhaustedBudget() const;
+		void seedRandomNumbers();
+
+		// Population array management
+		void setPopulation(Solution* first[], int firstSize, Solution* second[] = nullptr, int secondSize = 0);
+		void selectSurvivors();
+		void clearPopulation();
 
 		// Auxiliary functions for greedy initialization
-		int getRandomConfiguration(std::vector<int>& usedConfigs, int queryIndex);
-		int getHighestGainConfiguration(std::vector<int>& usedConfigs, int queryIndex);
+		int getRandomConfiguration(const std::vector<int>& usedConfigs, int queryIndex);		// usedConfigs counts the uses of each configuration
+		int getHighestGainConfiguration(const std::vector<int>& usedConfigs, int queryIndex);
 		int maxGainGivenQuery(int queryIndex);
 	};
 
@@ -76,8 +107,22 @@ class Genetic : public Algorithm
 private:
 
 	const Parameters* parameters;
-	vector<GeneticThread> threads;
-	mutex mtx;
+	vector<unique_ptr<GeneticThread>> threads;
+	vector<unique_ptr<MigrationChannel>> migrationChannels;		// Inbound channel of each island
+	vector<int> migrationTargets;								// Island receiving the emigrants of each island
+	unique_ptr<MigrationBarrier> migrationBarrier;				// Synchronous migrations of the seeded runs
+	unsigned long long generationShare, evaluationShare;		// Budget of each island, 0 if none
+
+	// Incumbent published without locks: its objective value for cheap checks,
+	// and an immutable snapshot of the whole solution replaced atomically (RCU-style)
+	atomic<long> bestObjective;
+	shared_ptr<const Solution> bestSnapshot;
+
+	SolutionWriter writer;		// Asynchronous output of the improving solutions
+	unique_ptr<WorkPool> evaluationPool;		// Helper threads shared by the islands for the batched evaluations
+	StatsReporter reporter;						// Live statistics of the islands, with --stats
+
+	friend class MicroBenchmark;
 	
 
 public:
@@ -89,6 +134,8 @@ public:
 
 private:
 
-	void updateBestSolution(const Solution& newBest);
+	bool updateBestSolution(const Solution& newBest);		// True if newBest has been published as the best solution
+	void reportStatistics(long long startingTime) const;		// Throughput of the islands and effectiveness of the caches
+	shared_ptr<const Solution> publishBestSolution(const Solution& newBest);
 
 };
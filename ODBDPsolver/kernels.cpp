@@ -0,0 +1,386 @@
+#include "utilities.hpp"
+
+#include <algorithm>
+#include <exception>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KERNEL_TARGET(isa)			// MSVC emits any instruction set without per-function options
+#elif defined(KERNELS_X86)
+#include <immintrin.h>
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+
+static inline int lowestBit(uint64_t word)		// Position of the least significant bit set (word != 0)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long position;
+	_BitScanForward64(&position, word);
+	return (int)position;
+#elif defined(_MSC_VER)
+	unsigned long position;
+	if (_BitScanForward(&position, (unsigned long)word))
+		return (int)position;
+	_BitScanForward(&position, (unsigned long)(word >> 32));
+	return (int)position + 32;
+#else
+	return __builtin_ctzll(word);
+#endif
+}
+
+
+/****	SCALAR KERNELS	****/
+
+
+static void orBitsScalar(uint64_t* dst, const uint64_t* src, int words)
+{
+	for (int w = 0; w < words; w++)
+		dst[w] |= src[w];
+}
+
+
+static long sumOverBitsScalar(const uint64_t* bits, int words, const int* values)
+{
+	long sum = 0;
+
+	for (int w = 0; w < words; w++)
+	{
+		// Visit only the bits set in the word, clearing the lowest one at each step
+		for (uint64_t word = bits[w]; word != 0; word &= word - 1)
+			sum += values[w * 64 + lowestBit(word)];
+	}
+
+	return sum;
+}
+
+
+static long sumOverNewBitsScalar(const uint64_t* row, const uint64_t* mask, int words, const int* values)
+{
+	long sum = 0;
+
+	for (int w = 0; w < words; w++)
+	{
+		for (uint64_t word = row[w] & ~mask[w]; word != 0; word &= word - 1)
+			sum += values[w * 64 + lowestBit(word)];
+	}
+
+	return sum;
+}
+
+
+static int findGainScalar(const GainEntry* entries, int size, int id)
+{
+	const GainEntry* end = entries + size;
+	const GainEntry* it = std::lower_bound(entries, end, id,
+		[](const GainEntry& entry, int id) { return entry.id < id; });
+
+	return (it != end && it->id == id) ? it->gain : 0;
+}
+
+
+// Narrows down the range that may contain id to at most maxSize entries, with a branchless binary search
+static inline const GainEntry* narrowGainRange(const GainEntry* entries, int& size, int id, int maxSize)
+{
+	while (size > maxSize)
+	{
+		int half = size / 2;
+		bool upper = entries[half - 1].id < id;		// id can only be in the upper half
+		entries = upper ? entries + half : entries;
+		size = upper ? size - half : half;
+	}
+
+	return entries;
+}
+
+
+#ifdef KERNELS_X86
+
+/****	AVX2 KERNELS	****/
+
+
+KERNEL_TARGET("avx2")
+static void orBitsAVX2(uint64_t* dst, const uint64_t* src, int words)
+{
+	int w = 0;
+
+	for (; w + 4 <= words; w += 4)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst + w));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src + w));
+		_mm256_storeu_si256((__m256i*)(dst + w), _mm256_or_si256(a, b));
+	}
+	for (; w < words; w++)
+		dst[w] |= src[w];
+}
+
+
+// Adds to acc the values selected by the bits of a word, 8 at a time through masked loads
+KERNEL_TARGET("avx2")
+static inline __m256i sumWordAVX2(uint64_t word, const int* values, __m256i acc)
+{
+	const __m256i lanes = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+	for (int b = 0; word != 0; b += 8, word >>= 8)
+	{
+		if ((word & 0xFF) == 0)
+			continue;
+
+		// Expand the 8 bits to lane masks, the values of the unset bits are not read
+		__m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32((int)(word & 0xFF)), lanes), lanes);
+		__m256i v = _mm256_maskload_epi32(values + b, mask);
+
+		// Accumulate on 64 bits, as the sums of the original kernels
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+		acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+	}
+
+	return acc;
+}
+
+
+KERNEL_TARGET("avx2")
+static inline long reduceAVX2(__m256i acc)
+{
+	__m128i sum = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+	sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+
+	int64_t result;
+	_mm_storel_epi64((__m128i*)&result, sum);
+	return (long)result;
+}
+
+
+KERNEL_TARGET("avx2")
+static long sumOverBitsAVX2(const uint64_t* bits, int words, const int* values)
+{
+	__m256i acc = _mm256_setzero_si256();
+
+	for (int w = 0; w < words; w++)
+	{
+		if (bits[w] != 0)
+			acc = sumWordAVX2(bits[w], values + w * 64, acc);
+	}
+
+	return reduceAVX2(acc);
+}
+
+
+KERNEL_TARGET("avx2")
+static long sumOverNewBitsAVX2(const uint64_t* row, const uint64_t* mask, int words, const int* values)
+{
+	__m256i acc = _mm256_setzero_si256();
+
+	for (int w = 0; w < words; w++)
+	{
+		uint64_t word = row[w] & ~mask[w];
+		if (word != 0)
+			acc = sumWordAVX2(word, values + w * 64, acc);
+	}
+
+	return reduceAVX2(acc);
+}
+
+
+KERNEL_TARGET("avx2")
+static int findGainAVX2(const GainEntry* entries, int size, int id)
+{
+	entries = narrowGainRange(entries, size, id, 8);
+
+	// Compare the ids of the remaining entries at once: (id, gain) pairs, ids in the even lanes
+	const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	__m256i valid0 = _mm256_cmpgt_epi32(_mm256_set1_epi32(2 * size), lanes);
+	__m256i valid1 = _mm256_cmpgt_epi32(_mm256_set1_epi32(2 * size - 8), lanes);
+	__m256i key = _mm256_set1_epi32(id);
+
+	__m256i v0 = _mm256_maskload_epi32((const int*)entries, valid0);
+	__m256i v1 = _mm256_maskload_epi32((const int*)entries + 8, valid1);
+	unsigned int found0 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(v0, key), valid0)));
+	unsigned int found1 = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpeq_epi32(v1, key), valid1)));
+
+	unsigned int found = (found0 | (found1 << 8)) & 0x5555;
+	return (found != 0) ? entries[lowestBit(found) / 2].gain : 0;
+}
+
+
+/****	AVX-512 KERNELS	****/
+
+
+KERNEL_TARGET("avx512f")
+static void orBitsAVX512(uint64_t* dst, const uint64_t* src, int words)
+{
+	for (int w = 0; w < words; w += 8)
+	{
+		__mmask8 mask = (words - w >= 8) ? (__mmask8)0xFF : (__mmask8)((1u << (words - w)) - 1);
+		__m512i a = _mm512_maskz_loadu_epi64(mask, dst + w);
+		__m512i b = _mm512_maskz_loadu_epi64(mask, src + w);
+		_mm512_mask_storeu_epi64(dst + w, mask, _mm512_or_si512(a, b));
+	}
+}
+
+
+// Adds to acc the values selected by the bits of a word, 16 at a time: the bits are directly the load mask
+KERNEL_TARGET("avx512f")
+static inline __m512i sumWordAVX512(uint64_t word, const int* values, __m512i acc)
+{
+	for (int b = 0; word != 0; b += 16, word >>= 16)
+	{
+		__mmask16 mask = (__mmask16)(word & 0xFFFF);
+		if (mask == 0)
+			continue;
+
+		__m512i v = _mm512_maskz_loadu_epi32(mask, values + b);
+		acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 0)));
+		acc = _mm512_add_epi64(acc, _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1)));
+	}
+
+	return acc;
+}
+
+
+KERNEL_TARGET("avx512f")
+static long sumOverBitsAVX512(const uint64_t* bits, int words, const int* values)
+{
+	__m512i acc = _mm512_setzero_si512();
+
+	for (int w = 0; w < words; w++)
+	{
+		if (bits[w] != 0)
+			acc = sumWordAVX512(bits[w], values + w * 64, acc);
+	}
+
+	return (long)_mm512_reduce_add_epi64(acc);
+}
+
+
+KERNEL_TARGET("avx512f")
+static long sumOverNewBitsAVX512(const uint64_t* row, const uint64_t* mask, int words, const int* values)
+{
+	__m512i acc = _mm512_setzero_si512();
+
+	for (int w = 0; w < words; w++)
+	{
+		uint64_t word = row[w] & ~mask[w];
+		if (word != 0)
+			acc = sumWordAVX512(word, values + w * 64, acc);
+	}
+
+	return (long)_mm512_reduce_add_epi64(acc);
+}
+
+
+KERNEL_TARGET("avx512f")
+static int findGainAVX512(const GainEntry* entries, int size, int id)
+{
+	entries = narrowGainRange(entries, size, id, 8);
+
+	// The (id, gain) pairs of the remaining entries fit in a single register, ids in the even lanes
+	__mmask16 valid = (__mmask16)((1u << (2 * size)) - 1);
+	__m512i v = _mm512_maskz_loadu_epi32(valid, entries);
+	unsigned int found = _mm512_mask_cmpeq_epi32_mask((__mmask16)(valid & 0x5555), v, _mm512_set1_epi32(id));
+
+	return (found != 0) ? entries[lowestBit(found) / 2].gain : 0;
+}
+
+#endif
+
+
+/****	RUNTIME DISPATCH	****/
+
+
+void (*orBits)(uint64_t* dst, const uint64_t* src, int words) = orBitsScalar;
+long (*sumOverBits)(const uint64_t* bits, int words, const int* values) = sumOverBitsScalar;
+long (*sumOverNewBits)(const uint64_t* row, const uint64_t* mask, int words, const int* values) = sumOverNewBitsScalar;
+int (*findGain)(const GainEntry* entries, int size, int id) = findGainScalar;
+
+
+static bool isSupported(KernelType kernels)		// Checks the CPUID flags, and that the OS saves the wider registers
+{
+	if (kernels == KERNEL_SCALAR)
+		return true;
+
+#if !defined(KERNELS_X86)
+	return false;
+#elif defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7)
+		return false;
+
+	__cpuid(info, 1);
+	if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)		// OSXSAVE and AVX
+		return false;
+
+	unsigned long long xcr0 = _xgetbv(0);
+	__cpuidex(info, 7, 0);
+
+	if (kernels == KERNEL_AVX2)
+		return (xcr0 & 0x06) == 0x06 && (info[1] & (1 << 5)) != 0;
+	if (kernels == KERNEL_AVX512)
+		return (xcr0 & 0xE6) == 0xE6 && (info[1] & (1 << 16)) != 0;
+	return false;
+#else
+	__builtin_cpu_init();
+
+	if (kernels == KERNEL_AVX2)
+		return __builtin_cpu_supports("avx2");
+	if (kernels == KERNEL_AVX512)
+		return __builtin_cpu_supports("avx512f");
+	return false;
+#endif
+}
+
+
+KernelType selectKernels(KernelType requested)
+{
+	KernelType kernels = requested;
+
+	if (kernels == KERNEL_AUTO)
+		kernels = isSupported(KERNEL_AVX512) ? KERNEL_AVX512 : (isSupported(KERNEL_AVX2) ? KERNEL_AVX2 : KERNEL_SCALAR);
+	else if (!isSupported(kernels))
+		throw exception("The requested kernels are not supported by this processor");
+
+	switch (kernels)
+	{
+#ifdef KERNELS_X86
+	case KERNEL_AVX2:
+		orBits = orBitsAVX2;
+		sumOverBits = sumOverBitsAVX2;
+		sumOverNewBits = sumOverNewBitsAVX2;
+		findGain = findGainAVX2;
+		break;
+
+	case KERNEL_AVX512:
+		orBits = orBitsAVX512;
+		sumOverBits = sumOverBitsAVX512;
+		sumOverNewBits = sumOverNewBitsAVX512;
+		findGain = findGainAVX512;
+		break;
+#endif
+
+	default:
+		orBits = orBitsScalar;
+		sumOverBits = sumOverBitsScalar;
+		sumOverNewBits = sumOverNewBitsScalar;
+		findGain = findGainScalar;
+		break;
+	}
+
+	return kernels;
+}
+
+
+const char* getKernelName(KernelType kernels)
+{
+	switch (kernels)
+	{
+	case KERNEL_SCALAR: return "scalar";
+	case KERNEL_AVX2: return "AVX2";
+	case KERNEL_AVX512: return "AVX-512";
+	default: return "auto";
+	}
+}
@@ -1,11 +1,11 @@
 #include "localsearch.hpp"
 
-#include <set>
+#include <vector>
 
 
 void LocalSearch::setStartingPoint(const Solution& sol)
 {
-	startingPoint = Solution(sol);
+	startingPoint = sol;
 }
 
 
@@ -16,80 +16,59 @@ Solution LocalSearch::run(const Parameters& parameters)
 	int mem = startingPoint.getMemoryCost();
 	int extra_mem, cost, gain;
 
-	std::vector<short> original = startingPoint.selectedConfigurations;
-	std::set<int> usedConfigs = std::set<int>(original.begin(), original.end());
+	Genome& selected = startingPoint.selectedConfigurations;
+	std::vector<bool> usedConfigs = std::vector<bool>(problemInstance.nConfigs, false);
 
-	std::vector<short> indexCounter = std::vector<short>(problemInstance.nIndexes, 0);
+	const int words = problemInstance.indexWords;
+	std::vector<uint64_t> builtIndexes = std::vector<uint64_t>(words, 0);
 
 	
-	// Count the number of times that each index is used by the 
-	// selected configurations serving all the different queries
+	// Mark the indexes that are used by the selected
+	// configurations serving all the different queries
 	for (int i = 0; i < problemInstance.nQueries; i++)
 	{
-		if (original[i] == -1)
-			continue;
-
-		for (int j = 0; j < problemInstance.nIndexes; j++)
+		if (selected[i] != -1)
 		{
-			if (problemInstance.configIndexesMatrix[original[i]][j])
-				indexCounter[j]++;
+			usedConfigs[selected[i]] = true;
+			orBits(builtIndexes.data(), problemInstance.getConfigIndexesRow(selected[i]), words);
 		}
 	}
 
 	// Iterate over all configurations
 	for (int i = 0; i < problemInstance.nConfigs; i++)
 	{
-		cost = 0, gain = 0;
-		extra_mem = 0;
+		// Gain of this configuration on the unserved queries, nothing to gain means nothing to check
+		gain = 0;
+		for (const GainEntry& entry : problemInstance.queriesWithGain(i)) {
+			if (selected[entry.id] < 0)
+				gain += entry.gain;
+		}
+		if (gain == 0)
+			continue;
+
+		cost = 0, extra_mem = 0;
 
-		if (usedConfigs.count(i) == 0)		// If the configuration is not active yet, it could provide a gain for our solution
+		// If the configuration is not active yet, indexes being used for the first time have to be built:
+		// consider their memory usage and time cost, unless building all of them already fits and pays off
+		if (!usedConfigs[i] && (gain <= problemInstance.configFixedCost[i] || mem + problemInstance.configMemory[i] > problemInstance.M))
 		{
-			for (int j = 0; j < problemInstance.nIndexes; j++)	{	 // Activate indexes needed by the configuration
-				if (problemInstance.configIndexesMatrix[i][j]) 
-				{
-					// If an index is being used for the first time, it has to be built
-					if (indexCounter[j] == 0) {							
-						extra_mem += problemInstance.indexesMemoryOccupation[j];	// Consider its memory usage
-						cost += problemInstance.indexesFixedCost[j];				// ...and its time cost 
-					}
-					indexCounter[j]++;
-				}
-			}
+			const uint64_t* row = problemInstance.getConfigIndexesRow(i);
+			extra_mem = (int)sumOverNewBits(row, builtIndexes.data(), words, problemInstance.indexesMemoryOccupation.data());
+			cost = (int)sumOverNewBits(row, builtIndexes.data(), words, problemInstance.indexesFixedCost.data());
 		}
 		
-		if (extra_mem + mem <= problemInstance.M)		// If the solution is still feasible...
+		if (extra_mem + mem <= problemInstance.M && gain > cost)	// If the configuration is feasible and provides an improvement...
 		{ 
-			// ...activate this configuration for all unserved queries that would benefit from it
-			for (int j = 0; j < problemInstance.queriesWithGain[i].size(); j++) {
-				int query = problemInstance.queriesWithGain[i][j];
-				if (startingPoint.selectedConfigurations[query] < 0) 
-				{
-					startingPoint.selectedConfigurations[query] = i;
-					gain += problemInstance.configQueriesGain[i][query];
-				}
-			}
-
-			if (gain > cost)	// If the activated configuration has provided an improvement...
-			{
-				startingPoint.evaluate();		// ...stop the local search
-				break;
-			}
-			else	// Otherwise backtrack and reset the solution to its original status
-			{
-				startingPoint.selectedConfigurations = original;
-
-				// Deactivate indexes that were built only for this config
-				if (usedConfigs.count(i) == 0)
-				{
-					for (int j = 0; j < problemInstance.nIndexes; j++) {
-						if (problemInstance.configIndexesMatrix[i][j])
-							indexCounter[j]--;
-					}
-				}
+			// ...activate it for all unserved queries that benefit from it
+			for (const GainEntry& entry : problemInstance.queriesWithGain(i)) {
+				if (selected[entry.id] < 0)
+					selected[entry.id] = i;
 			}
 
+			startingPoint.evaluate(evaluationCache);		// ...and stop the local search
+			break;
 		}
 	}
 
 	return startingPoint;
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "algorithm.hpp"
+#include "evaluationcache.hpp"
 
 
 class LocalSearch : public Algorithm
@@ -9,16 +10,19 @@ class LocalSearch : public Algorithm
 private:
 
 	Solution startingPoint;
+	EvaluationCache* evaluationCache;		// Optional cache of the thread running the local search
 
 
 public:
 
 	LocalSearch(Instance& inst)
 		: Algorithm(inst),
-		startingPoint(Solution(bestSolution))
+		startingPoint(Solution(bestSolution)),
+		evaluationCache(nullptr)
 	{ };
 
 	void setStartingPoint(const Solution& sol);
+	void setEvaluationCache(EvaluationCache* cache) { evaluationCache = cache; }
 	Solution run(const Parameters& parameters);
 
 private:
@@ -1,8 +1,13 @@
 #include <iostream>
 #include <exception>
+#include <algorithm>
 
 #include "utilities.hpp"
-#include "genetic.hpp"
+#include "algorithm.hpp"
+#include "upperbound.hpp"
+#include "stoptoken.hpp"
+#include "batch.hpp"
+#include "benchmark.hpp"
 
 
 int main(int argc, char **argv)
@@ -10,12 +15,68 @@ int main(int argc, char **argv)
 	Parameters executionParameters;
 	Instance problemInstance;
 
+	// SIGINT and SIGTERM stop the search, which still writes out its best solution
+	StopToken::installSignalHandlers();
+
 	try
 	{	// Command line parameters parsing
 		executionParameters = parseCommandLine(argc, argv);
 
+		// Evaluation kernels, chosen from the instruction sets supported by the CPU
+		executionParameters.kernels = selectKernels(executionParameters.kernels);
+		fprintf_s(stdout, "Using %s evaluation kernels\n", getKernelName(executionParameters.kernels));
+
+		// Benchmark mode: repeated batch runs, compared with the baseline; regressions make the process fail
+		if (executionParameters.benchmarkRuns > 0)
+		{
+			Benchmark benchmark(executionParameters);
+			benchmark.load(executionParameters.batchPath);
+			return benchmark.run() > 0 ? EXIT_FAILURE : 0;
+		}
+
+		// Batch mode: solve all the instances of a directory or manifest, then exit
+		if (executionParameters.batchPath.length() > 0)
+		{
+			Batch batch(executionParameters);
+			batch.load(executionParameters.batchPath);
+			batch.run();
+			return 0;
+		}
+
 		// Read problem instance from input file
 		problemInstance.readInputFile(executionParameters.inputFileName);
+		fprintf_s(stdout, "Instance read in %.2f ms (%.1f MB/s)\n", problemInstance.inputTime_ms,
+			problemInstance.inputBytes / (1024.0 * 1024.0) / (std::max(problemInstance.inputTime_ms, 0.001) / 1000.0));
+
+		// Conversion mode: store the instance in the binary format and exit
+		if (executionParameters.binaryFileName.length() > 0)
+		{
+			problemInstance.writeBinaryFile(executionParameters.binaryFileName);
+			std::cout << "Instance converted to binary file '" << executionParameters.binaryFileName << "'" << std::endl;
+			return 0;
+		}
+
+		// The statistics file is checked before the search starts its threads, the reporter opens it again
+		if (executionParameters.statsInterval > 0 && executionParameters.statsFileName.length() > 0)
+		{
+			FILE* fl = nullptr;
+			fopen_s(&fl, executionParameters.statsFileName.c_str(), "w");
+			if (fl == nullptr)
+				throw exception(("Error: unable to write the statistics on file '" + executionParameters.statsFileName + "'").c_str());
+			fclose(fl);
+		}
+
+		// Reduce the instance before the search
+		if (executionParameters.presolve)
+		{
+			PresolveStats stats = problemInstance.presolve();
+			int removedConfigs = stats.noGainConfigs + stats.oversizedConfigs + stats.unprofitableConfigs + stats.dominatedConfigs;
+
+			fprintf_s(stdout, "Presolve removed %d of %d configurations (%d without gain, %d oversized, %d unprofitable, %d dominated)"
+				" and %d of %d indexes in %.2f ms\n", removedConfigs, problemInstance.originalConfigs, stats.noGainConfigs,
+				stats.oversizedConfigs, stats.unprofitableConfigs, stats.dominatedConfigs,
+				stats.removedIndexes, problemInstance.originalIndexes, stats.time_ms);
+		}
 	}
 	catch (std::exception& e)
 	{
@@ -23,14 +84,27 @@ int main(int argc, char **argv)
 		exit(EXIT_FAILURE);
 	}
 	
-	// Instantiate the proper class and run the algorithm
-	Genetic solver(problemInstance);
-	Solution solution = solver.run(executionParameters);
+	// Bound on the optimal objective value, to measure the gap of the solutions found
+	UpperBound bound(problemInstance);
+	bound.compute();
+	fprintf_s(stdout, "Upper bound = %ld (Lagrange multiplier %.4g, computed in %.2f ms)\n",
+		bound.getValue(), bound.getMultiplier(), bound.getTime_ms());
+
+	// Instantiate the selected engine and run the algorithm
+	std::unique_ptr<Algorithm> solver(createAlgorithm(executionParameters.algorithm, problemInstance));
+
+	solver->setUpperBound(&bound);
+	Solution solution = solver->run(executionParameters);
+
+	if (StopToken::getInterruptSignal() != 0)
+		fprintf_s(stdout, "\nSearch interrupted by signal %d, the best solution found has been saved\n", StopToken::getInterruptSignal());
 	
 	std::cout << "\nAlgorithm execution terminated succesfully!"
 		<< "\nObjective function value = " << solution.getObjFunctionValue()
 		<< "\nMemory cost = " << solution.getMemoryCost()
-		<< std::endl << std::endl;
+		<< std::endl;
+	fprintf_s(stdout, "Optimality gap = %.2f%% (upper bound %ld)\n\n",
+		UpperBound::getGap(solution.getObjFunctionValue(), solver->getBound()), solver->getBound());
 
 	return 0;
 }
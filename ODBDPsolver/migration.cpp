@@ -0,0 +1,67 @@
+#include "migration.hpp"
+
+#include <algorithm>
+#include <climits>
+
+
+MigrationChannel::MigrationChannel(int genomeLength, size_t capacity)
+	: slots(capacity, vector<short>(genomeLength, -1)),
+	mask(capacity - 1),
+	head(0), tail(0)
+{
+}
+
+
+bool MigrationChannel::push(const short* genome)
+{
+	size_t t = tail.load(memory_order_relaxed);
+
+	if (t - head.load(memory_order_acquire) == slots.size())
+		return false;
+
+	// Fill the slot before making it visible to the consumer
+	std::copy(genome, genome + slots[t & mask].size(), slots[t & mask].begin());
+	tail.store(t + 1, memory_order_release);
+
+	return true;
+}
+
+
+bool MigrationChannel::pop(short* genome)
+{
+	size_t h = head.load(memory_order_relaxed);
+
+	if (h == tail.load(memory_order_acquire))
+		return false;
+
+	// Copy the genome out before handing the slot back to the producer
+	std::copy(slots[h & mask].begin(), slots[h & mask].end(), genome);
+	head.store(h + 1, memory_order_release);
+
+	return true;
+}
+
+
+
+MigrationBarrier::MigrationBarrier(int islands)
+	: progress(islands, 0)
+{
+}
+
+
+void MigrationBarrier::arrive(int island, unsigned long long step)
+{
+	unique_lock<mutex> lock(progressMutex);
+	progress[island] = step;
+	progressed.notify_all();
+
+	progressed.wait(lock, [this, step] { return *std::min_element(progress.begin(), progress.end()) >= step; });
+}
+
+
+void MigrationBarrier::leave(int island)
+{
+	lock_guard<mutex> lock(progressMutex);
+	progress[island] = ULLONG_MAX;
+	progressed.notify_all();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+
+#define MIGRATION_CHANNEL_CAPACITY 8		// Genomes, must be a power of 2
+
+using namespace std;
+
+
+/*
+** MigrationChannel is a bounded lock-free ring buffer of genomes connecting two islands of the genetic algorithm:
+** exactly one thread may push into it and exactly one thread may pop from it, neither of them ever blocks.
+** Genome slots are preallocated, so transferring a genome only copies it without any heap allocation
+*/
+class MigrationChannel
+{
+
+private:
+
+	vector<vector<short>> slots;
+	size_t mask;
+
+	alignas(64) atomic<size_t> head;	// Next slot to read, written only by the consumer
+	alignas(64) atomic<size_t> tail;	// Next slot to write, written only by the producer
+
+
+public:
+
+	MigrationChannel(int genomeLength, size_t capacity = MIGRATION_CHANNEL_CAPACITY);
+	MigrationChannel(const MigrationChannel& other) = delete;
+	MigrationChannel& operator=(const MigrationChannel& other) = delete;
+
+	bool push(const short* genome);		// Producer side, returns false when the channel is full
+	bool pop(short* genome);			// Consumer side, returns false when the channel is empty (genome is left untouched)
+
+};
+
+
+/*
+** MigrationBarrier makes the migrations of a seeded run deterministic: the islands push their emigrants, wait for
+** each other, pop their immigrants and wait again, so every exchange happens at the same generation whatever the
+** scheduling of the threads. Islands that have stopped leave the barrier, which then waits only for the others
+*/
+class MigrationBarrier
+{
+
+private:
+
+	mutex progressMutex;
+	condition_variable progressed;
+	vector<unsigned long long> progress;		// Last step reached by each island, the maximum value once it has left
+
+
+public:
+
+	MigrationBarrier(int islands);
+
+	void arrive(int island, unsigned long long step);		// Waits until all the islands still running have reached the step
+	void leave(int island);
+
+};
@@ -0,0 +1,22 @@
+#include "random.hpp"
+
+#include "utilities.hpp"
+
+
+void Xoshiro256pp::seed(uint64_t seed)
+{
+	// Consecutive SplitMix64 outputs, the initialization recommended by the authors of the generator
+	for (int i = 0; i < 4; i++)
+		state[i] = deriveSeed(seed, i);
+}
+
+
+void Pcg32::seed(uint64_t seed)
+{
+	// Stream and starting point both derived from the seed, as in pcg32_srandom
+	state = 0;
+	increment = (deriveSeed(seed, 1) << 1) | 1;
+	(*this)();
+	state += deriveSeed(seed, 0);
+	(*this)();
+}
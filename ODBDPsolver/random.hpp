@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <climits>
+#include <cmath>
+#include <random>
+
+
+using namespace std;
+
+
+/*
+** Random number engines of the genetic operators, both much cheaper than std::mt19937 and with a state that fits
+** in a cache line: xoshiro256++ (64-bit outputs, the default) and PCG32 (XSH-RR, 32-bit outputs). RandomEngine is
+** chosen at build time, defining RANDOM_ENGINE_PCG32 or RANDOM_ENGINE_MT19937 (to compare with the old engine),
+** so the draws can be inlined. Both engines are standard uniform random bit generators
+*/
+class Xoshiro256pp
+{
+
+public:
+
+	typedef uint64_t result_type;
+
+private:
+
+	uint64_t state[4];
+
+
+public:
+
+	explicit Xoshiro256pp(uint64_t seed = 0) { this->seed(seed); }
+
+	void seed(uint64_t seed);		// The state is expanded from the seed with SplitMix64, never all zeros
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT64_MAX; }
+
+	result_type operator()()
+	{
+		uint64_t result = rotate(state[0] + state[3], 23) + state[0];
+		uint64_t t = state[1] << 17;
+
+		state[2] ^= state[0];
+		state[3] ^= state[1];
+		state[1] ^= state[2];
+		state[0] ^= state[3];
+		state[2] ^= t;
+		state[3] = rotate(state[3], 45);
+
+		return result;
+	}
+
+private:
+
+	static uint64_t rotate(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+};
+
+
+class Pcg32
+{
+
+public:
+
+	typedef uint32_t result_type;
+
+private:
+
+	uint64_t state;
+	uint64_t increment;		// Odd, selects the stream
+
+
+public:
+
+	explicit Pcg32(uint64_t seed = 0) { this->seed(seed); }
+
+	void seed(uint64_t seed);
+
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return UINT32_MAX; }
+
+	result_type operator()()
+	{
+		uint64_t old = state;
+		state = old * 6364136223846793005ULL + increment;
+
+		uint32_t xorShifted = (uint32_t)(((old >> 18) ^ old) >> 27);
+		uint32_t rotation = (uint32_t)(old >> 59);
+		return (xorShifted >> rotation) | (xorShifted << ((32 - rotation) & 31));
+	}
+
+};
+
+
+#if defined(RANDOM_ENGINE_PCG32)
+typedef Pcg32 RandomEngine;
+#elif defined(RANDOM_ENGINE_MT19937)
+typedef std::mt19937 RandomEngine;
+#else
+typedef Xoshiro256pp RandomEngine;
+#endif
+
+
+// Top 32 bits of a draw, the best ones of all the engines
+template <class Engine>
+inline uint32_t random32(Engine& engine)
+{
+	if (Engine::max() > UINT32_MAX)
+		return (uint32_t)((uint64_t)engine() >> 32);
+	return (uint32_t)engine();
+}
+
+
+// Uniform integer in [0, range), with range > 0: Lemire's multiply-shift, unbiased, a division only
+// in the rare case of a draw falling in the rejection zone
+template <class Engine>
+inline uint32_t randomBelow(Engine& engine, uint32_t range)
+{
+	uint64_t product = (uint64_t)random32(engine) * range;
+	uint32_t low = (uint32_t)product;
+
+	if (low < range)
+	{
+		uint32_t threshold = (0u - range) % range;		// 2^32 mod range
+		while (low < threshold)
+		{
+			product = (uint64_t)random32(engine) * range;
+			low = (uint32_t)product;
+		}
+	}
+
+	return (uint32_t)(product >> 32);
+}
+
+
+// Uniform real number in (0, 1], with 53 random bits
+template <class Engine>
+inline double randomUnit(Engine& engine)
+{
+	uint64_t bits = (Engine::max() > UINT32_MAX) ? (uint64_t)engine() : ((uint64_t)random32(engine) << 32) | random32(engine);
+	return ((bits >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+
+// Failed trials before the first success, for independent trials of probability p: scale is 1 / log(1 - p)
+// (-0 if p = 1). Replaces a draw for each trial with a single draw and a logarithm for each success
+template <class Engine>
+inline int randomGeometric(Engine& engine, double scale)
+{
+	double failures = std::log(randomUnit(engine)) * scale;
+	return failures < (double)INT_MAX ? (int)failures : INT_MAX;
+}
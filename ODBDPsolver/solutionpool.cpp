@@ -0,0 +1,66 @@
+#include "solutionpool.hpp"
+
+#include <new>
+
+
+SolutionPool::SolutionPool(Instance& inst, size_t initialCapacity)
+	: problemInstance(inst), capacity(0), acquisitions(0)
+{
+	if (initialCapacity > 0)
+		addSlab(initialCapacity);
+}
+
+SolutionPool::~SolutionPool()
+{
+	// The solutions go before the buffer of their genomes
+	for (Slab& slab : slabs)
+	{
+		for (size_t i = 0; i < slab.size; i++)
+			slab.solutions[i].~Solution();
+		::operator delete(slab.solutions);
+	}
+}
+
+
+Solution* SolutionPool::acquire()
+{
+	if (freeSolutions.empty())		// The pool only grows when all of its solutions are in use
+		addSlab(SOLUTION_SLAB_SIZE);
+
+	Solution* sol = freeSolutions.back();
+	freeSolutions.pop_back();
+	acquisitions++;
+
+	return sol;
+}
+
+
+void SolutionPool::release(Solution* sol)
+{
+	freeSolutions.push_back(sol);		// Never reallocates, the stack is reserved for the whole capacity
+}
+
+
+void SolutionPool::addSlab(size_t size)
+{
+	Slab slab;
+	slab.size = size;
+
+	// One buffer for all the genomes of the slab, carved in order without any padding (the genes are 2-byte aligned)
+	slab.genomes = vector<short>(size * problemInstance.nQueries);
+	slab.genomeStorage.reset(new std::pmr::monotonic_buffer_resource(slab.genomes.data(),
+		slab.genomes.size() * sizeof(short), std::pmr::null_memory_resource()));
+
+	// Construct a block of adjacent solutions, their buffers are allocated once here and then reused
+	slab.solutions = static_cast<Solution*>(::operator new(sizeof(Solution) * size));
+	for (size_t i = 0; i < size; i++)
+		new (&slab.solutions[i]) Solution(problemInstance, slab.genomeStorage.get());
+
+	// Hand out the solutions in address order
+	capacity += size;
+	freeSolutions.reserve(capacity);
+	for (size_t i = size; i > 0; i--)
+		freeSolutions.push_back(&slab.solutions[i - 1]);
+
+	slabs.push_back(std::move(slab));
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <memory_resource>
+
+#include "utilities.hpp"
+
+
+#define SOLUTION_SLAB_SIZE 64
+
+using namespace std;
+
+
+/*
+** SolutionPool keeps a per-thread reserve of Solution objects, allocated in slabs: the first one holds the initial
+** capacity, the next ones SOLUTION_SLAB_SIZE solutions each. The genomes of a slab are stored back to back in a single
+** buffer, so scanning a population walks adjacent memory. Recycled solutions are handed out again without any heap
+** allocation, since copy-assigning a Solution of the same instance reuses its buffers. The pool is not thread-safe,
+** each worker thread must own its own
+*/
+class SolutionPool
+{
+
+	struct Slab {
+		Solution* solutions;
+		size_t size;
+		vector<short> genomes;										// size x nQueries genes
+		unique_ptr<std::pmr::monotonic_buffer_resource> genomeStorage;	// Hands out the genomes buffer in order, never the heap
+	};
+
+private:
+
+	Instance& problemInstance;
+	vector<Slab> slabs;
+	vector<Solution*> freeSolutions;		// Stack of the solutions available for reuse
+	size_t capacity;
+	unsigned long long acquisitions;
+
+
+public:
+
+	SolutionPool(Instance& inst, size_t initialCapacity = 0);
+	SolutionPool(const SolutionPool& other) = delete;
+	SolutionPool& operator=(const SolutionPool& other) = delete;
+	~SolutionPool();
+
+	Solution* acquire();				// O(1), the returned solution holds stale data until it is reset or assigned
+	void release(Solution* sol);		// O(1), the solution must have been acquired from this pool
+
+	size_t size() const { return capacity; }
+	unsigned long long getAcquisitions() const { return acquisitions; }		// Solutions handed out by acquire(), reused or new
+
+private:
+
+	void addSlab(size_t size);
+
+};
@@ -0,0 +1,118 @@
+#include "solutionwriter.hpp"
+
+#include <cstdio>
+#include <climits>
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#endif
+
+
+SolutionWriter::SolutionWriter()
+	: sparseFormat(false), bestSubmittedObjective(LONG_MIN), stopping(false),
+	submittedSolutions(0), writtenSolutions(0)
+{
+}
+
+SolutionWriter::~SolutionWriter()
+{
+	stop();
+}
+
+
+void SolutionWriter::start(const string& outputFileName, bool sparse)
+{
+	stop();
+
+	fileName = outputFileName;
+	sparseFormat = sparse;
+	stopping = false;
+	bestSubmittedObjective = LONG_MIN;
+	submittedSolutions = 0, writtenSolutions = 0;
+
+	worker = thread(&SolutionWriter::run, this);
+}
+
+
+void SolutionWriter::submit(shared_ptr<const Solution> sol)
+{
+	{
+		lock_guard<mutex> lock(mtx);
+		submittedSolutions++;
+
+		if (sol->getObjFunctionValue() <= bestSubmittedObjective)
+			return;
+
+		pending = sol;				// Replaces any older solution still waiting to be written
+		bestSubmittedObjective = sol->getObjFunctionValue();
+	}
+
+	wakeUp.notify_one();
+}
+
+
+void SolutionWriter::stop()
+{
+	if (!worker.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(mtx);
+		stopping = true;
+	}
+
+	wakeUp.notify_one();
+	worker.join();
+}
+
+
+void SolutionWriter::run()
+{
+	unique_lock<mutex> lock(mtx);
+
+	while (true)
+	{
+		wakeUp.wait(lock, [this] { return pending != nullptr || stopping; });
+
+		if (pending == nullptr)		// Stopping, with everything already written
+			break;
+
+		// Take the newest solution and write it without holding the lock
+		shared_ptr<const Solution> sol = pending;
+		pending = nullptr;
+
+		lock.unlock();
+		write(*sol);
+		lock.lock();
+	}
+}
+
+
+void SolutionWriter::write(const Solution& sol)
+{
+	string temporaryFileName = fileName + ".tmp";
+
+	try
+	{
+		sol.writeToFile(temporaryFileName, sparseFormat);
+
+		// Replace the output file in a single step, readers never see a partially written solution
+#ifdef _WIN32
+		if (!MoveFileExA(temporaryFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+		if (rename(temporaryFileName.c_str(), fileName.c_str()) != 0)
+#endif
+		{
+			throw exception(("Error: unable to replace file '" + fileName + "'").c_str());
+		}
+
+		writtenSolutions++;
+	}
+	catch (exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "utilities.hpp"
+
+using namespace std;
+
+
+/*
+** SolutionWriter owns a background thread that stores the improving solutions on the output file, so the
+** threads finding them never wait for disk I/O: bursts of submissions are coalesced and only the newest
+** solution is written, first on a temporary file which then atomically replaces the output file
+*/
+class SolutionWriter
+{
+
+private:
+
+	string fileName;
+	bool sparseFormat;
+
+	thread worker;
+	mutex mtx;
+	condition_variable wakeUp;
+	shared_ptr<const Solution> pending;		// Newest submitted solution, not yet written
+	long bestSubmittedObjective;			// Guards against older solutions submitted late by slower threads
+	bool stopping;
+
+	unsigned long long submittedSolutions;
+	unsigned long long writtenSolutions;
+
+
+public:
+
+	SolutionWriter();
+	SolutionWriter(const SolutionWriter& other) = delete;
+	SolutionWriter& operator=(const SolutionWriter& other) = delete;
+	~SolutionWriter();
+
+	void start(const string& outputFileName, bool sparse);
+	void submit(shared_ptr<const Solution> sol);		// Never waits for the file to be written
+	void stop();										// Writes the last pending solution, then joins the writer thread
+
+	unsigned long long getSubmittedSolutions() const { return submittedSolutions; }
+	unsigned long long getWrittenSolutions() const { return writtenSolutions; }
+
+private:
+
+	void run();		// Writer thread entry point
+	void write(const Solution& sol);
+
+};
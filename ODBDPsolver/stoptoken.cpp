@@ -0,0 +1,77 @@
+#include "stoptoken.hpp"
+
+#include <csignal>
+
+
+atomic<int> StopToken::interruptSignal(0);
+
+
+StopToken::StopToken()
+	: reason(NONE),
+	deadline(chrono::steady_clock::time_point::max())
+{
+}
+
+
+void StopToken::setBudget(long long budget_ms)
+{
+	deadline = chrono::steady_clock::now() + chrono::milliseconds(budget_ms);
+	reason = NONE;
+}
+
+
+void StopToken::requestStop(Reason why)
+{
+	int expected = NONE;
+	reason.compare_exchange_strong(expected, why);
+}
+
+
+bool StopToken::checkDeadline()
+{
+	if (interruptSignal.load(memory_order_relaxed) != 0)
+		requestStop(INTERRUPT);
+	else if (chrono::steady_clock::now() >= deadline)
+		requestStop(DEADLINE);
+
+	return reason.load(memory_order_relaxed) != NONE;
+}
+
+
+StopToken::Reason StopToken::getReason() const
+{
+	// A signal may have arrived after the last check of the token
+	if (reason.load() == NONE && interruptSignal.load() != 0)
+		return INTERRUPT;
+
+	return (Reason)reason.load();
+}
+
+
+const char* StopToken::getReasonName(Reason why)
+{
+	switch (why)
+	{
+	case DEADLINE: return "stopped by the time limit";
+	case GOAL: return "the goal has been reached";
+	case INTERRUPT: return "interrupted by a signal";
+	case BUDGET: return "the budget has been exhausted";
+	default: return "not stopped";
+	}
+}
+
+
+void StopToken::installSignalHandlers()
+{
+	std::signal(SIGINT, handleSignal);
+	std::signal(SIGTERM, handleSignal);
+}
+
+
+void StopToken::handleSignal(int signal)
+{
+	// Only lock-free atomic stores are safe here, the workers notice the signal at their next check;
+	// the default handler is restored so that a second signal terminates the process at once
+	interruptSignal.store(signal);
+	std::signal(signal, SIG_DFL);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+
+
+#define STOP_CHECK_INTERVAL 64		// Calls of shouldStop() between two readings of the clock
+
+using namespace std;
+
+
+/*
+** StopToken is shared by the threads of a search to stop it cooperatively. It is raised when the deadline on the
+** monotonic clock expires, when the search reaches its goal, or when the process receives SIGINT/SIGTERM
+** (searches that stop after a budget of generations or evaluations report it as their reason).
+** Testing the token costs a relaxed atomic load, the clock is read only once every few calls of shouldStop()
+*/
+class StopToken
+{
+
+public:
+
+	enum Reason { NONE, DEADLINE, GOAL, INTERRUPT, BUDGET };
+
+private:
+
+	atomic<int> reason;
+	chrono::steady_clock::time_point deadline;
+
+	static atomic<int> interruptSignal;		// Last signal received, raises every token
+
+
+public:
+
+	StopToken();
+
+	void setBudget(long long budget_ms);		// Starts the countdown to the deadline, and clears previous requests
+	void requestStop(Reason why);				// The first reason given is kept
+
+	bool stopRequested() const
+	{
+		return reason.load(memory_order_relaxed) != NONE || interruptSignal.load(memory_order_relaxed) != 0;
+	}
+
+	bool checkDeadline();		// Also reads the clock, raising the token once the deadline has expired
+
+	// Amortized test for the loops of the workers: calls counts the calls made by the thread
+	bool shouldStop(unsigned long long& calls, unsigned int interval = STOP_CHECK_INTERVAL)
+	{
+		return (++calls % interval == 0) ? checkDeadline() : stopRequested();
+	}
+
+	Reason getReason() const;
+	static const char* getReasonName(Reason why);
+
+	static void installSignalHandlers();
+	static int getInterruptSignal() { return interruptSignal.load(); }
+
+private:
+
+	static void handleSignal(int signal);
+
+};
@@ -0,0 +1,177 @@
+#include "threadstats.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+
+ThreadCounters::ThreadCounters()
+{
+	for (int c = 0; c < N_COUNTERS; c++)
+		counters[c].store(0);
+	for (int p = 0; p < N_PHASES; p++)
+		phaseTime_ns[p].store(0);
+}
+
+
+long long ThreadCounters::now_ns()
+{
+	using namespace chrono;
+	return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+
+const char* ThreadCounters::getCounterName(Counter counter)
+{
+	switch (counter)
+	{
+	case GENERATIONS: return "generations";
+	case EVALUATIONS: return "evaluations";
+	case LOCAL_SEARCHES: return "local_searches";
+	case LOCAL_SEARCH_IMPROVEMENTS: return "local_search_improvements";
+	case RESTARTS: return "restarts";
+	case IMPROVEMENTS: return "improvements";
+	case ACQUIRED_SOLUTIONS: return "acquired_solutions";
+	default: return "unknown";
+	}
+}
+
+
+const char* ThreadCounters::getPhaseName(Phase phase)
+{
+	switch (phase)
+	{
+	case PHASE_INITIALIZE: return "initialize";
+	case PHASE_BREED: return "breed";
+	case PHASE_FULL_EVALUATION: return "full_evaluation";
+	case PHASE_SELECT: return "select";
+	case PHASE_LOCAL_SEARCH: return "local_search";
+	default: return "unknown";
+	}
+}
+
+
+
+StatsReporter::StatsReporter()
+	: interval_ms(0),
+	json(false),
+	output(nullptr),
+	startingTime(0),
+	previous(),
+	stopRequested(false)
+{
+}
+
+StatsReporter::~StatsReporter()
+{
+	stop();
+}
+
+
+void StatsReporter::start(const vector<const ThreadCounters*>& threadCounters, const Parameters& parameters)
+{
+	if (parameters.statsInterval == 0)
+		return;
+
+	sources = threadCounters;
+	interval_ms = parameters.statsInterval;
+	json = parameters.statsJson;
+	output = stdout;
+	if (parameters.statsFileName.length() > 0)
+	{
+		fopen_s(&output, parameters.statsFileName.c_str(), "w");
+		if (output == nullptr)
+			throw exception(("Error: unable to write the statistics on file '" + parameters.statsFileName + "'").c_str());
+	}
+
+	startingTime = getCurrentTime_ms();
+	previous = takeSnapshot();
+	stopRequested = false;
+	worker = thread(&StatsReporter::run, this);
+}
+
+
+void StatsReporter::stop()
+{
+	if (!worker.joinable())
+		return;
+
+	{
+		lock_guard<mutex> lock(stopMutex);
+		stopRequested = true;
+	}
+	stopping.notify_one();
+	worker.join();
+
+	if (output != stdout)
+		fclose(output);
+	output = nullptr;
+}
+
+
+void StatsReporter::run()
+{
+	unique_lock<mutex> lock(stopMutex);
+
+	// Report at every interval, and once more when stopped
+	while (!stopping.wait_for(lock, chrono::milliseconds(interval_ms), [this] { return stopRequested; }))
+		report();
+	report();
+}
+
+
+void StatsReporter::report()
+{
+	Snapshot current = takeSnapshot();
+	double interval_s = std::max(current.time_s - previous.time_s, 0.001);
+	double threadTime_s = std::max(current.time_s, 0.001) * sources.size();
+
+	if (json)
+	{
+		fprintf_s(output, "{\"time_s\": %.3f, \"threads\": [", current.time_s);
+		for (size_t i = 0; i < sources.size(); i++)
+		{
+			fprintf_s(output, "%s{\"thread\": %d", i > 0 ? ", " : "", (int)i + 1);
+			for (int c = 0; c < ThreadCounters::N_COUNTERS; c++)
+				fprintf_s(output, ", \"%s\": %llu", ThreadCounters::getCounterName((ThreadCounters::Counter)c),
+					sources[i]->get((ThreadCounters::Counter)c));
+			for (int p = 0; p < N_PHASES; p++)
+				fprintf_s(output, ", \"%s_s\": %.3f", ThreadCounters::getPhaseName((Phase)p), sources[i]->getTime_s((Phase)p));
+			fprintf_s(output, "}");
+		}
+		fprintf_s(output, "]}\n");
+	}
+	else
+	{
+		const unsigned long long* counters = current.counters;
+		fprintf_s(output, "Statistics at %.1f s: %llu generations (%.1f/s), %llu evaluations (%.0f/s), %llu local searches (%llu improving),"
+			" %llu restarts, %llu improvements, %llu solutions acquired; time in", current.time_s,
+			counters[ThreadCounters::GENERATIONS], (counters[ThreadCounters::GENERATIONS] - previous.counters[ThreadCounters::GENERATIONS]) / interval_s,
+			counters[ThreadCounters::EVALUATIONS], (counters[ThreadCounters::EVALUATIONS] - previous.counters[ThreadCounters::EVALUATIONS]) / interval_s,
+			counters[ThreadCounters::LOCAL_SEARCHES], counters[ThreadCounters::LOCAL_SEARCH_IMPROVEMENTS], counters[ThreadCounters::RESTARTS],
+			counters[ThreadCounters::IMPROVEMENTS], counters[ThreadCounters::ACQUIRED_SOLUTIONS]);
+		fprintf_s(output, " initialize %.1f%%, breed %.1f%%, full evaluations %.1f%%, select %.1f%%, local search %.1f%%\n",
+			100 * current.phaseTime_s[PHASE_INITIALIZE] / threadTime_s, 100 * current.phaseTime_s[PHASE_BREED] / threadTime_s, 100 * current.phaseTime_s[PHASE_FULL_EVALUATION] / threadTime_s,
+			100 * current.phaseTime_s[PHASE_SELECT] / threadTime_s, 100 * current.phaseTime_s[PHASE_LOCAL_SEARCH] / threadTime_s);
+	}
+	fflush(output);
+
+	previous = current;
+}
+
+
+StatsReporter::Snapshot StatsReporter::takeSnapshot() const
+{
+	Snapshot snapshot = Snapshot();
+	snapshot.time_s = (getCurrentTime_ms() - startingTime) / 1000.0;
+
+	for (const ThreadCounters* source : sources)
+	{
+		for (int c = 0; c < ThreadCounters::N_COUNTERS; c++)
+			snapshot.counters[c] += source->get((ThreadCounters::Counter)c);
+		for (int p = 0; p < N_PHASES; p++)
+			snapshot.phaseTime_s[p] += source->getTime_s((Phase)p);
+	}
+
+	return snapshot;
+}
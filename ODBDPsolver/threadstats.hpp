@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+#include "utilities.hpp"
+
+
+#define CACHE_LINE_SIZE 64
+
+using namespace std;
+
+
+// Steps of the islands, timed separately: the greedy construction of the populations, the breeding (the offsprings are
+// scored incrementally by crossover and mutation, so their scoring is part of it), the full evaluations of new
+// populations and immigrants, the replacement, the local searches
+enum Phase { PHASE_INITIALIZE, PHASE_BREED, PHASE_FULL_EVALUATION, PHASE_SELECT, PHASE_LOCAL_SEARCH, N_PHASES };
+
+
+/*
+** ThreadCounters is the block of statistics of a worker thread. Only its owner writes it, with relaxed loads and stores
+** instead of atomic read-modify-write instructions, while the reporter can read it at any time; each block starts
+** on its own cache line, so the threads never share the lines they write. Cheap enough to be always on
+*/
+struct alignas(CACHE_LINE_SIZE) ThreadCounters
+{
+	enum Counter { GENERATIONS, EVALUATIONS, LOCAL_SEARCHES, LOCAL_SEARCH_IMPROVEMENTS, RESTARTS, IMPROVEMENTS, ACQUIRED_SOLUTIONS, N_COUNTERS };
+
+	atomic<unsigned long long> counters[N_COUNTERS];
+	atomic<long long> phaseTime_ns[N_PHASES];
+
+
+	ThreadCounters();
+
+	void add(Counter counter, unsigned long long amount = 1)
+	{
+		counters[counter].store(counters[counter].load(memory_order_relaxed) + amount, memory_order_relaxed);
+	}
+
+	void set(Counter counter, unsigned long long value) { counters[counter].store(value, memory_order_relaxed); }
+	unsigned long long get(Counter counter) const { return counters[counter].load(memory_order_relaxed); }
+
+	void addTime(Phase phase, long long elapsed_ns)
+	{
+		phaseTime_ns[phase].store(phaseTime_ns[phase].load(memory_order_relaxed) + elapsed_ns, memory_order_relaxed);
+	}
+
+	double getTime_s(Phase phase) const { return phaseTime_ns[phase].load(memory_order_relaxed) / 1e9; }
+
+	static long long now_ns();		// Monotonic clock for the phase timers
+	static const char* getCounterName(Counter counter);
+	static const char* getPhaseName(Phase phase);
+};
+
+
+/*
+** StatsReporter prints the counters of a search every --stats interval, from a thread of its own: a text line
+** with the totals of all the threads, or a JSON line with the block of each thread (--stats-format json),
+** on stdout or on the --stats-output file. The rates are those of the last interval, the phases are shares of the
+** time of the threads. A last report is written when the reporter stops
+*/
+class StatsReporter
+{
+
+	// Totals of all the threads
+	struct Snapshot {
+		double time_s;
+		unsigned long long counters[ThreadCounters::N_COUNTERS];
+		double phaseTime_s[N_PHASES];
+	};
+
+private:
+
+	vector<const ThreadCounters*> sources;
+	unsigned int interval_ms;
+	bool json;
+	FILE* output;
+	long long startingTime;
+	Snapshot previous;
+
+	thread worker;
+	mutex stopMutex;
+	condition_variable stopping;
+	bool stopRequested;
+
+
+public:
+
+	StatsReporter();
+	~StatsReporter();
+
+	void start(const vector<const ThreadCounters*>& threadCounters, const Parameters& parameters);	// Nothing to do without --stats
+	void stop();
+
+private:
+
+	void run();
+	void report();
+	Snapshot takeSnapshot() const;
+
+};
@@ -0,0 +1,114 @@
+#include "upperbound.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+UpperBound::UpperBound(const Instance& inst)
+	: problemInstance(inst),
+	configCostShare(inst.nConfigs, 0),
+	configMemoryShare(inst.nConfigs, 0),
+	multiplier(0),
+	value(0),
+	time_ms(0)
+{
+	for (int c = 0; c < inst.nConfigs; c++)
+	{
+		for (int k : inst.indexesOfConfig(c))
+		{
+			int users = std::max(inst.indexQueries[k], 1);
+			configCostShare[c] += (double)inst.indexesFixedCost[k] / users;
+			configMemoryShare[c] += (double)inst.indexesMemoryOccupation[k] / users;
+		}
+	}
+}
+
+
+void UpperBound::compute()
+{
+	using namespace chrono;
+	steady_clock::time_point startTime = steady_clock::now();
+
+	// Relaxation without the memory constraint, tightened by the multiplier only if the configurations chosen exceed the memory
+	double subgradient;
+	multiplier = 0;
+	value = evaluate(0, subgradient);
+
+	if (subgradient < 0)
+	{
+		// Raise the multiplier until the configurations chosen fit in the memory
+		double low = 0, high = 1;
+		for (int i = 0; i < 64; i++)
+		{
+			double bound = evaluate(high, subgradient);
+			if (bound < value)
+				value = bound, multiplier = high;
+			if (subgradient >= 0)
+				break;
+
+			low = high, high *= 2;
+		}
+
+		// Any multiplier gives a valid bound, the lowest one found is kept
+		for (int i = 0; i < UPPER_BOUND_ITERATIONS; i++)
+		{
+			double lambda = (low + high) / 2;
+			double bound = evaluate(lambda, subgradient);
+			if (bound < value)
+				value = bound, multiplier = lambda;
+
+			if (subgradient < 0)
+				low = lambda;
+			else
+				high = lambda;
+		}
+	}
+
+	time_ms = duration<double, milli>(steady_clock::now() - startTime).count();
+}
+
+
+double UpperBound::evaluate(double lambda, double& subgradient) const
+{
+	const Instance& inst = problemInstance;
+
+	// Solutions are feasible with at most M-1 units of memory
+	double bound = lambda * (inst.M - 1);
+	subgradient = inst.M - 1;
+
+	for (int q = 0; q < inst.nQueries; q++)
+	{
+		double best = 0, bestMemory = 0;
+		for (const GainEntry& entry : inst.configServingQueries(q))
+		{
+			if (entry.gain <= 0 || inst.configMemory[entry.id] >= inst.M)
+				continue;
+
+			double contribution = entry.gain - configCostShare[entry.id] - lambda * configMemoryShare[entry.id];
+			if (contribution > best)
+				best = contribution, bestMemory = configMemoryShare[entry.id];
+		}
+
+		bound += best;
+		subgradient -= bestMemory;
+	}
+
+	return bound;
+}
+
+
+long UpperBound::getValue() const
+{
+	// Objective values are integers, the tolerance absorbs the rounding errors of the shares
+	return std::max((long)std::floor(value + 1e-6), 0L);
+}
+
+
+double UpperBound::getGap(long objective, long bound)
+{
+	if (bound <= 0 || objective >= bound)
+		return 0;
+
+	return 100.0 * (bound - std::max(objective, 0L)) / bound;
+}
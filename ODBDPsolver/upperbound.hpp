@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+
+#include "utilities.hpp"
+
+
+#define UPPER_BOUND_ITERATIONS 50		// Bisection steps on the Lagrange multiplier
+
+using namespace std;
+
+
+/*
+** UpperBound computes a bound on the optimal objective value, from a Lagrangian relaxation of the memory constraint.
+** The fixed cost of each index, and its memory weighted by the multiplier, are charged in equal shares to the queries
+** that could use it, so the relaxed problem splits into an independent choice of the best configuration for each query.
+** The bound is convex in the multiplier, which is found by bisection on the subgradient (the memory left unused)
+*/
+class UpperBound
+{
+
+private:
+
+	const Instance& problemInstance;
+
+	vector<double> configCostShare;		// Sum of the cost shares of the indexes of each configuration
+	vector<double> configMemoryShare;	// Sum of the memory shares of the indexes of each configuration
+
+	double multiplier;			// Lagrange multiplier of the memory constraint giving the lowest bound
+	double value;
+	double time_ms;
+
+
+public:
+
+	UpperBound(const Instance& inst);
+
+	void compute();
+
+	long getValue() const;					// Bound on the objective, rounded down to an integer
+	double getMultiplier() const { return multiplier; }
+	double getTime_ms() const { return time_ms; }
+
+	static double getGap(long objective, long bound);		// Optimality gap of an objective value, as a percentage of the bound
+
+private:
+
+	double evaluate(double lambda, double& subgradient) const;
+
+};
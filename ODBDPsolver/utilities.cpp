@@ -1,18 +1,72 @@
 #include "utilities.hpp"
+#include "workpool.hpp"
+#include "evaluationcache.hpp"
 
 #include <limits>
+#include <cmath>
 #include <chrono>
+#include <algorithm>
 #include <exception>
+#include <charconv>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+#define BINARY_INSTANCE_MAGIC "ODBDPBIN"
+#define BINARY_INSTANCE_VERSION 1
+
+
+typedef struct BinaryHeader		// Leading block of a binary instance file, followed by 8-byte aligned data sections
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	int32_t nQueries;
+	int32_t nIndexes;
+	int32_t nConfigs;
+	int32_t M;
+	int32_t indexWords;
+	int32_t nGainEntries;		// Non-zero elements of the g matrix
+	int32_t nIndexEntries;		// Non-zero elements of the e matrix
+	int32_t reserved;
+} BinaryInstanceHeader;
+
+
+#define COMMAND_LINE_FORMAT "\n$ODBDPsolver_OMAAL_group04.exe <instancefilename> -t <seconds>[s]|<milliseconds>ms [-j <threads>]\
+ [--migration-interval <generations>] [--migration-topology ring|random] [--output-format dense|sparse]\
+ [--eval-threads <threads>]\
+ [--kernel auto|scalar|avx2|avx512] [--no-presolve] [--algorithm ga|bnb]\
+ [--gap <percent>] [--target <objective>]\
+ [--seed <seed>] [--generations <generations>] [--evaluations <evaluations>]\
+ [--stats <seconds>[s]|<milliseconds>ms [--stats-format text|json] [--stats-output <filename>]]\
+ [--batch <directory|manifest> [--batch-jobs <jobs>] [--summary <filename>]]\
+ [--benchmark <runs> [--budgets <limit>,...] [--bench-output <prefix>] [--baseline <summaryfile>] [--tolerance <percent>]]\
+ [-c <binaryfilename>]"
 
 
 Parameters parseCommandLine(int argc, char *argv[])
 {	
 	Parameters execParams = Params();
+	bool timeLimitGiven = false;
 
-	if (argc != 2 && argc != 4)
+	// Use all the available hardware threads by default
+	execParams.nThreads = std::thread::hardware_concurrency();
+	if (execParams.nThreads == 0)
+		execParams.nThreads = DEFAULT_THREADS;
+
+	if (argc < 2)
 	{
-		throw exception("Wrong command line format, expected:\
-			\n$ODBDPsolver_OMAAL_group04.exe <instancefilename> -t <timelimit>");
+		throw exception("Wrong command line format, expected:" COMMAND_LINE_FORMAT);
 	}
 	else
 	{
@@ -21,7 +75,216 @@ Parameters parseCommandLine(int argc, char *argv[])
 			// Parsing the -t <timelimit> parameter, which takes up 2 consecutive args
 			if (strcmp(argv[i], "-t") == 0 && i < argc-1)		
 			{
-				execParams.timeLimit = (unsigned) atoi(argv[i + 1])*1000;
+				execParams.timeLimit = parseTimeLimit(argv[i + 1]);
+				timeLimitGiven = true;
+				i++;
+			}
+			// Parsing the -j/--threads <threads> parameter
+			else if ((strcmp(argv[i], "-j") == 0 || strcmp(argv[i], "--threads") == 0) && i < argc-1)
+			{
+				if (atoi(argv[i + 1]) <= 0)
+					throw exception("The number of threads must be a positive integer");
+
+				execParams.nThreads = (unsigned) atoi(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --migration-interval <generations> parameter
+			else if (strcmp(argv[i], "--migration-interval") == 0 && i < argc-1)
+			{
+				if (atoi(argv[i + 1]) < 0)
+					throw exception("The migration interval must be a non-negative integer");
+
+				execParams.migrationInterval = (unsigned) atoi(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --migration-topology ring|random parameter
+			else if (strcmp(argv[i], "--migration-topology") == 0 && i < argc-1)
+			{
+				if (strcmp(argv[i + 1], "ring") != 0 && strcmp(argv[i + 1], "random") != 0)
+					throw exception("The migration topology must be either 'ring' or 'random'");
+
+				execParams.randomMigrationTopology = strcmp(argv[i + 1], "random") == 0;
+				i++;
+			}
+			// Parsing the --output-format dense|sparse parameter
+			else if (strcmp(argv[i], "--output-format") == 0 && i < argc-1)
+			{
+				if (strcmp(argv[i + 1], "dense") != 0 && strcmp(argv[i + 1], "sparse") != 0)
+					throw exception("The output format must be either 'dense' or 'sparse'");
+
+				execParams.sparseOutput = strcmp(argv[i + 1], "sparse") == 0;
+				i++;
+			}
+			// Parsing the --eval-threads <threads> parameter
+			else if (strcmp(argv[i], "--eval-threads") == 0 && i < argc-1)
+			{
+				if (atoi(argv[i + 1]) < 0)
+					throw exception("The number of evaluation threads must be a non-negative integer");
+
+				execParams.evaluationThreads = (unsigned) atoi(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --kernel auto|scalar|avx2|avx512 parameter
+			else if (strcmp(argv[i], "--kernel") == 0 && i < argc-1)
+			{
+				if (strcmp(argv[i + 1], "auto") == 0)
+					execParams.kernels = KERNEL_AUTO;
+				else if (strcmp(argv[i + 1], "scalar") == 0)
+					execParams.kernels = KERNEL_SCALAR;
+				else if (strcmp(argv[i + 1], "avx2") == 0)
+					execParams.kernels = KERNEL_AVX2;
+				else if (strcmp(argv[i + 1], "avx512") == 0)
+					execParams.kernels = KERNEL_AVX512;
+				else
+					throw exception("The kernels must be one of 'auto', 'scalar', 'avx2' or 'avx512'");
+				i++;
+			}
+			// Parsing the --no-presolve parameter
+			else if (strcmp(argv[i], "--no-presolve") == 0)
+			{
+				execParams.presolve = false;
+			}
+			// Parsing the --algorithm ga|bnb parameter
+			else if (strcmp(argv[i], "--algorithm") == 0 && i < argc-1)
+			{
+				if (strcmp(argv[i + 1], "ga") != 0 && strcmp(argv[i + 1], "bnb") != 0)
+					throw exception("The algorithm must be either 'ga' (genetic) or 'bnb' (branch and bound)");
+
+				execParams.algorithm = strcmp(argv[i + 1], "bnb") == 0 ? ALGORITHM_BRANCH_AND_BOUND : ALGORITHM_GENETIC;
+				i++;
+			}
+			// Parsing the --gap <percent> parameter
+			else if (strcmp(argv[i], "--gap") == 0 && i < argc-1)
+			{
+				if (atof(argv[i + 1]) < 0)
+					throw exception("The optimality gap must be a non-negative percentage");
+
+				execParams.targetGap = atof(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --target <objective> parameter
+			else if (strcmp(argv[i], "--target") == 0 && i < argc-1)
+			{
+				execParams.targetObjective = atol(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --seed <seed> parameter
+			else if (strcmp(argv[i], "--seed") == 0 && i < argc-1)
+			{
+				char* end;
+				execParams.seed = strtoull(argv[i + 1], &end, 10);
+				if (*end != '\0' || argv[i + 1][0] == '-')
+					throw exception("The seed must be a non-negative integer");
+
+				execParams.fixedSeed = true;
+				i++;
+			}
+			// Parsing the --generations <generations> parameter
+			else if (strcmp(argv[i], "--generations") == 0 && i < argc-1)
+			{
+				if (atoll(argv[i + 1]) <= 0)
+					throw exception("The generation budget must be a positive integer");
+
+				execParams.generationBudget = (unsigned long long) atoll(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --evaluations <evaluations> parameter
+			else if (strcmp(argv[i], "--evaluations") == 0 && i < argc-1)
+			{
+				if (atoll(argv[i + 1]) <= 0)
+					throw exception("The evaluation budget must be a positive integer");
+
+				execParams.evaluationBudget = (unsigned long long) atoll(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --stats <interval> parameter, given as the time limit
+			else if (strcmp(argv[i], "--stats") == 0 && i < argc-1)
+			{
+				execParams.statsInterval = parseTimeLimit(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --stats-format text|json parameter
+			else if (strcmp(argv[i], "--stats-format") == 0 && i < argc-1)
+			{
+				if (strcmp(argv[i + 1], "text") != 0 && strcmp(argv[i + 1], "json") != 0)
+					throw exception("The statistics format must be either 'text' or 'json'");
+
+				execParams.statsJson = strcmp(argv[i + 1], "json") == 0;
+				i++;
+			}
+			// Parsing the --stats-output <filename> parameter
+			else if (strcmp(argv[i], "--stats-output") == 0 && i < argc-1)
+			{
+				execParams.statsFileName = std::string(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --batch <directory|manifest> parameter, which replaces the instance file name
+			else if (strcmp(argv[i], "--batch") == 0 && i < argc-1)
+			{
+				execParams.batchPath = std::string(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --batch-jobs <jobs> parameter
+			else if (strcmp(argv[i], "--batch-jobs") == 0 && i < argc-1)
+			{
+				if (atoi(argv[i + 1]) <= 0)
+					throw exception("The number of batch jobs must be a positive integer");
+
+				execParams.batchJobs = (unsigned) atoi(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --summary <filename> parameter
+			else if (strcmp(argv[i], "--summary") == 0 && i < argc-1)
+			{
+				execParams.summaryFileName = std::string(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --benchmark <runs> parameter, which turns the batch into a benchmark
+			else if (strcmp(argv[i], "--benchmark") == 0 && i < argc-1)
+			{
+				if (atoi(argv[i + 1]) <= 0)
+					throw exception("The number of benchmark runs must be a positive integer");
+
+				execParams.benchmarkRuns = (unsigned) atoi(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --budgets <limit>,... parameter, each limit given as with -t
+			else if (strcmp(argv[i], "--budgets") == 0 && i < argc-1)
+			{
+				string budgets = argv[i + 1];
+				execParams.benchmarkBudgets.clear();
+				for (size_t first = 0, last; first <= budgets.length(); first = last + 1)
+				{
+					last = std::min(budgets.find(',', first), budgets.length());
+					execParams.benchmarkBudgets.push_back(parseTimeLimit(budgets.substr(first, last - first).c_str()));
+				}
+				i++;
+			}
+			// Parsing the --bench-output <prefix> parameter
+			else if (strcmp(argv[i], "--bench-output") == 0 && i < argc-1)
+			{
+				execParams.benchmarkPrefix = std::string(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --baseline <summaryfile> parameter
+			else if (strcmp(argv[i], "--baseline") == 0 && i < argc-1)
+			{
+				execParams.baselineFileName = std::string(argv[i + 1]);
+				i++;
+			}
+			// Parsing the --tolerance <percent> parameter
+			else if (strcmp(argv[i], "--tolerance") == 0 && i < argc-1)
+			{
+				if (atof(argv[i + 1]) < 0)
+					throw exception("The regression tolerance must be a non-negative percentage");
+
+				execParams.regressionTolerance = atof(argv[i + 1]);
+				i++;
+			}
+			// Parsing the -c <binaryfilename> parameter, which requests the conversion of the instance
+			else if (strcmp(argv[i], "-c") == 0 && i < argc-1)
+			{
+				execParams.binaryFileName = std::string(argv[i + 1]);
 				i++;
 			}
 			// Parsing the <inputfilename> parameter, also generating the output filename
@@ -32,28 +295,204 @@ Parameters parseCommandLine(int argc, char *argv[])
 			}
 			else	// Unknown parameter handling										
 			{
-				throw exception("Command line parsing error, expected:\
-					\n$ODBDPsolver_OMAAL_group04.exe <instancefilename> -t <timelimit>");
+				throw exception("Command line parsing error, expected:" COMMAND_LINE_FORMAT);
 			}
 		}
 	}
 
+	// A budget replaces the default time limit, so the wall clock cannot cut short a reproducible run
+	if ((execParams.generationBudget > 0 || execParams.evaluationBudget > 0) && !timeLimitGiven)
+	{
+		execParams.timeLimit = UINT_MAX;
+	}
+	// Benchmarks run on the bundled instances, unless others are given with --batch
+	if (execParams.benchmarkRuns > 0 && execParams.inputFileName.length() == 0 && execParams.batchPath.length() == 0)
+	{
+		execParams.batchPath = string(DEFAULT_BENCHMARK_INSTANCES);
+	}
+	if (execParams.inputFileName.length() == 0 && execParams.batchPath.length() == 0)
+	{
+		throw exception("Missing instance file name, expected:" COMMAND_LINE_FORMAT);
+	}
+	if (execParams.inputFileName.length() > 0 && execParams.batchPath.length() > 0)
+	{
+		throw exception("An instance file name cannot be given together with --batch");
+	}
+	if (execParams.benchmarkRuns > 0 && execParams.inputFileName.length() > 0)
+	{
+		throw exception("The benchmark runs on a directory or manifest of instances, given with --batch");
+	}
+
 	return execParams;
 }
 
 
-long long getCurrentTime_ms()		// Returns system time in milliseconds
+unsigned int parseTimeLimit(const char* text)		// Seconds, with decimals and the optional 's' suffix, or milliseconds with the 'ms' suffix
+{
+	char* unit;
+	double limit = strtod(text, &unit);
+	if (strcmp(unit, "ms") != 0 && strcmp(unit, "s") != 0 && *unit != '\0')
+		throw exception("The time limit must be given in seconds, optionally with the 's' suffix, or in milliseconds with the 'ms' suffix");
+	if (strcmp(unit, "ms") != 0)
+		limit *= 1000;
+	if (!std::isfinite(limit) || limit < 1 || limit > UINT_MAX)
+		throw exception("The time limit must be between 1 ms and 49 days");
+
+	return (unsigned int)limit;
+}
+
+
+uint64_t deriveSeed(uint64_t seed, uint64_t stream)		// SplitMix64 step, distinct streams give uncorrelated seeds
+{
+	uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+
+long long getCurrentTime_ms()		// Returns the time in milliseconds on a monotonic clock, for measuring intervals
 {
 	using namespace chrono;
-	return duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+	return duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
 }
 
 
+/****	MAPPEDFILE CLASS	****/
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& fileName)
+	: mappedData(nullptr), mappedSize(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL)
+{
+	fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		throw exception(("Error when attempting to open and read file '" + fileName + "'\n").c_str());
+	}
+
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(fileHandle, &fileSize);
+	mappedSize = (size_t)fileSize.QuadPart;
+
+	if (mappedSize > 0)		// Empty files cannot be mapped
+	{
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mappingHandle != NULL)
+			mappedData = (const char*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+
+		if (mappedData == nullptr)
+		{
+			if (mappingHandle != NULL) CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			throw exception(("Error when attempting to map file '" + fileName + "' in memory\n").c_str());
+		}
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (mappedData != nullptr) UnmapViewOfFile(mappedData);
+	if (mappingHandle != NULL) CloseHandle(mappingHandle);
+	if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& fileName)
+	: mappedData(nullptr), mappedSize(0), fileDescriptor(-1)
+{
+	fileDescriptor = open(fileName.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		throw exception(("Error when attempting to open and read file '" + fileName + "'\n").c_str());
+	}
+
+	struct stat fileStatus;
+	fstat(fileDescriptor, &fileStatus);
+	mappedSize = (size_t)fileStatus.st_size;
+
+	if (mappedSize > 0)		// Empty files cannot be mapped
+	{
+		void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		if (mapping == MAP_FAILED)
+		{
+			close(fileDescriptor);
+			throw exception(("Error when attempting to map file '" + fileName + "' in memory\n").c_str());
+		}
+		madvise(mapping, mappedSize, MADV_SEQUENTIAL);
+		mappedData = (const char*)mapping;
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (mappedData != nullptr) munmap((void*)mappedData, mappedSize);
+	if (fileDescriptor >= 0) close(fileDescriptor);
+}
+
+#endif
+
+
+/****	TEXTTOKENIZER CLASS	****/
+
+
+class TextTokenizer		// Splits a text buffer into whitespace separated tokens
+{
+
+private:
+
+	const char* cursor;
+	const char* end;
+
+public:
+
+	TextTokenizer(const char* begin, const char* end)
+		: cursor(begin), end(end)
+	{ };
+
+	std::string nextWord()		// Returns an empty string at the end of the buffer
+	{
+		skipSpaces();
+		const char* first = cursor;
+		while (cursor < end && !isSpace(*cursor))
+			cursor++;
+
+		return std::string(first, cursor);
+	}
+
+	int nextInt()
+	{
+		skipSpaces();
+		int value = 0;
+		std::from_chars_result result = std::from_chars(cursor, end, value);
+		if (result.ec != std::errc() || (result.ptr < end && !isSpace(*result.ptr)))
+			throw exception("Error in the instance file format: integer value expected\n");
+
+		cursor = result.ptr;
+		return value;
+	}
+
+private:
+
+	static bool isSpace(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+	void skipSpaces()
+	{
+		while (cursor < end && isSpace(*cursor))
+			cursor++;
+	}
+
+};
+
+
 /****	INSTANCE CLASS	****/
 
 
 Instance::Instance()
-	: M(0), nConfigs(0), nQueries(0), nIndexes(0)
+	: M(0), nConfigs(0), nQueries(0), nIndexes(0), indexWords(0),
+	inputBytes(0), inputTime_ms(0)
 {
 }
 
@@ -64,118 +503,576 @@ Instance::~Instance()
 
 void Instance::readInputFile(const std::string& fileName)
 {
-	FILE* fl;
-	fopen_s(&fl, fileName.c_str(), "r");
-	if (fl == NULL)
+	using namespace chrono;
+	steady_clock::time_point startTime = steady_clock::now();
+	MappedFile file(fileName);
+
+	// Binary instances are recognized by their magic number, anything else is parsed as text
+	if (file.size() >= sizeof(BinaryInstanceHeader) &&
+		memcmp(file.data(), BINARY_INSTANCE_MAGIC, sizeof(BinaryInstanceHeader::magic)) == 0)
 	{
-		throw exception(("Error when attempting to open and read file '" + fileName + "'\n").c_str());
+		readBinaryFile(file);
 	}
+	else readTextFile(file);
 
-	// Read problem instance size values
-	int l = fscanf_s(fl, "%*s%u", &this->nQueries);
-	l += fscanf_s(fl, "%*s%u", &this->nIndexes);
-	l += fscanf_s(fl, "%*s%u", &this->nConfigs);
-	l += fscanf_s(fl, "%*s%u", &this->M);
+	// Identity numbering, until a presolve
+	originalConfigs = nConfigs;
+	originalIndexes = nIndexes;
+	originalConfigIds = vector<int>(nConfigs);
+	originalIndexIds = vector<int>(nIndexes);
+	for (int i = 0; i < nConfigs; i++)
+		originalConfigIds[i] = i;
+	for (int k = 0; k < nIndexes; k++)
+		originalIndexIds[k] = k;
 
-	if (l != 4)
-		throw exception("Error in the instance file format\n");
+	buildAggregates();
 
-	fscanf_s(fl, "%*s");	// Skip a row
+	// Keep track of the loading throughput
+	inputBytes = file.size();
+	inputTime_ms = duration_cast<microseconds>(steady_clock::now() - startTime).count() / 1000.0;
+}
 
 
-	// Read the CONFIGURATION_INDEX_MATRIX
-	configIndexesMatrix.clear();
-	configIndexesMatrix.reserve(nConfigs);
-	for (int i = 0; i < nConfigs; i++)
+void Instance::readTextFile(const MappedFile& file)
+{
+	TextTokenizer tokens(file.data(), file.data() + file.size());
+	bool sizesRead[4] = { false }, sectionsRead[4] = { false };
+
+	// Read problem instance size values, each one identified by its name
+	for (int n = 0; n < 4; n++)
 	{
-		configIndexesMatrix.emplace_back(vector<short int>(nIndexes, 0));
-		for (short int j = 0; j < nIndexes; j++)
-			fscanf_s(fl, "%hd", &configIndexesMatrix[i][j]);
+		std::string name = tokens.nextWord();
+		int value = tokens.nextInt();
+
+		if (name == "N_QUERIES:") nQueries = value, sizesRead[0] = true;
+		else if (name == "N_INDEXES:") nIndexes = value, sizesRead[1] = true;
+		else if (name == "N_CONFIGURATIONS:") nConfigs = value, sizesRead[2] = true;
+		else if (name == "MEMORY:") M = value, sizesRead[3] = true;
+		else throw exception(("Error in the instance file format: unexpected field '" + name + "'\n").c_str());
 	}
 
-	fscanf_s(fl, "%*s");	// Skip a row
+	if (!(sizesRead[0] && sizesRead[1] && sizesRead[2] && sizesRead[3]) || nQueries < 0 || nIndexes < 0 || nConfigs < 0)
+		throw exception("Error in the instance file format\n");
+
+	// Read the data sections, each one introduced by its header
+	for (std::string name = tokens.nextWord(); name.length() > 0 && name != "EOF"; name = tokens.nextWord())
+	{
+		if (name == "CONFIGURATIONS_INDEXES_MATRIX:")
+		{
+			// Pack each row of the e matrix into a bitset, keeping track of the indexes required by the configuration
+			indexWords = (nIndexes + 63) / 64;
+			configIndexesBits = vector<uint64_t>((size_t)nConfigs * indexWords, 0);
+			configIndexOffsets = vector<int>(1, 0);
+			configIndexList.clear();
+
+			for (int i = 0; i < nConfigs; i++)
+			{
+				for (int j = 0; j < nIndexes; j++)
+				{
+					if (tokens.nextInt() == 1) {
+						configIndexesBits[(size_t)i * indexWords + j / 64] |= (uint64_t)1 << (j % 64);
+						configIndexList.emplace_back(j);
+					}
+				}
+				configIndexOffsets.emplace_back((int)configIndexList.size());
+			}
+			sectionsRead[0] = true;
+		}
+		else if (name == "INDEXES_FIXED_COST:")
+		{
+			indexesFixedCost = vector<int>(nIndexes, 0);
+			for (int i = 0; i < nIndexes; i++)
+				indexesFixedCost[i] = tokens.nextInt();
+			sectionsRead[1] = true;
+		}
+		else if (name == "INDEXES_MEMORY_OCCUPATION:")
+		{
+			indexesMemoryOccupation = vector<int>(nIndexes, 0);
+			for (int i = 0; i < nIndexes; i++)
+				indexesMemoryOccupation[i] = tokens.nextInt();
+			sectionsRead[2] = true;
+		}
+		else if (name == "CONFIGURATIONS_QUERIES_GAIN:")
+		{
+			// Store only the non-zero elements of the g matrix
+			configGainOffsets = vector<int>(nConfigs + 1, 0);
+			configGainEntries.clear();
+			queryGainOffsets = vector<int>(nQueries + 1, 0);
+
+			for (int i = 0; i < nConfigs; i++)
+			{
+				for (int j = 0; j < nQueries; j++)
+				{
+					int gain = tokens.nextInt();
+
+					// Append the non-zero elements to the configuration row and count them for each query
+					if (gain > 0) {
+						configGainEntries.push_back({ j, gain });
+						queryGainOffsets[j + 1]++;
+					}
+				}
+				configGainOffsets[i + 1] = (int)configGainEntries.size();
+			}
 
+			// Populate the query columns, scattering the row elements in configuration order
+			for (int j = 0; j < nQueries; j++)
+				queryGainOffsets[j + 1] += queryGainOffsets[j];
 
-	// Allocate and read fixed_cost of each index
-	indexesFixedCost = vector<int>(nIndexes, 0);
-	for (int i = 0; i < nIndexes; i++) {
-		fscanf_s(fl, "%u", &indexesFixedCost[i]);
+			queryGainEntries = vector<GainEntry>(configGainEntries.size());
+			vector<int> position(queryGainOffsets.begin(), queryGainOffsets.end() - 1);
+			for (int i = 0; i < nConfigs; i++)
+			{
+				for (const GainEntry& entry : queriesWithGain(i))
+					queryGainEntries[position[entry.id]++] = { i, entry.gain };
+			}
+			sectionsRead[3] = true;
+		}
+		else throw exception(("Error in the instance file format: unknown section '" + name + "'\n").c_str());
 	}
 
-	fscanf_s(fl, "%*s");	// Skip a row
+	if (!(sectionsRead[0] && sectionsRead[1] && sectionsRead[2] && sectionsRead[3]))
+		throw exception("Error in the instance file format: missing section\n");
+}
+
+
+// Returns the size of a data section padded to the 8-byte alignment of the binary format
+static size_t alignedSize(size_t bytes)
+{
+	return (bytes + 7) & ~(size_t)7;
+}
+
+
+// Points to the next section of a mapped binary instance, checking it fits inside the file
+template <typename T>
+static const T* nextSection(const char*& cursor, const char* end, size_t count)
+{
+	const T* section = (const T*)cursor;
+	// Huge counts are rejected before multiplying, so the size cannot wrap around
+	if (count > (size_t)(end - cursor) / sizeof(T) || (size_t)(end - cursor) < alignedSize(count * sizeof(T)))
+		throw exception("Error in the binary instance file format: truncated file\n");
+
+	size_t bytes = alignedSize(count * sizeof(T));
+
+	cursor += bytes;
+	return section;
+}
+
+
+// Checks the offsets of a CSR/CSC section: starting at 0, never decreasing and ending at the number of entries
+static void checkOffsets(const int32_t* offsets, int count, int32_t entries)
+{
+	if (offsets[0] != 0 || offsets[count] != entries)
+		throw exception("Error in the binary instance file format: inconsistent sections\n");
+
+	for (int i = 0; i < count; i++)
+	{
+		if (offsets[i] > offsets[i + 1])
+			throw exception("Error in the binary instance file format: inconsistent sections\n");
+	}
+}
 
 
-	// Allocate and read memory_cost of each index
-	indexesMemoryOccupation = vector<int>(nIndexes, 0);
-	for (int i = 0; i < nIndexes; i++) {
-		fscanf_s(fl, "%u", &indexesMemoryOccupation[i]);
+// Checks the numbers stored in the lists of a CSR/CSC section: inside [0, limit) and increasing inside each list
+template <typename T, typename GetId>
+static void checkIds(const int32_t* offsets, int count, const T* entries, int limit, GetId getId)
+{
+	for (int i = 0; i < count; i++)
+	{
+		for (int k = offsets[i]; k < offsets[i + 1]; k++)
+		{
+			int id = getId(entries[k]);
+			if (id < 0 || id >= limit || (k > offsets[i] && id <= getId(entries[k - 1])))
+				throw exception("Error in the binary instance file format: invalid number in a list\n");
+		}
 	}
+}
 
-	fscanf_s(fl, "%*s");	// Skip a row
 
+void Instance::readBinaryFile(const MappedFile& file)
+{
+	if (file.size() < sizeof(BinaryInstanceHeader))
+		throw exception("Error in the binary instance file format: truncated file\n");
+
+	const BinaryInstanceHeader* header = (const BinaryInstanceHeader*)file.data();
+	if (header->version != BINARY_INSTANCE_VERSION || header->headerSize != sizeof(BinaryInstanceHeader))
+		throw exception("Unsupported binary instance file version\n");
+
+	nQueries = header->nQueries;
+	nIndexes = header->nIndexes;
+	nConfigs = header->nConfigs;
+	M = header->M;
+	indexWords = header->indexWords;
+
+	if (nQueries < 0 || nIndexes < 0 || nConfigs < 0 || indexWords != ((long long)nIndexes + 63) / 64 ||
+		header->nGainEntries < 0 || header->nIndexEntries < 0)
+		throw exception("Error in the binary instance file format: inconsistent header\n");
+
+	// Locate all the data sections inside the mapping
+	const char* cursor = file.data() + sizeof(BinaryInstanceHeader);
+	const char* end = file.data() + file.size();
+
+	const uint64_t* bits = nextSection<uint64_t>(cursor, end, (size_t)nConfigs * indexWords);
+	const int32_t* fixedCost = nextSection<int32_t>(cursor, end, nIndexes);
+	const int32_t* memoryOccupation = nextSection<int32_t>(cursor, end, nIndexes);
+	const int32_t* rowOffsets = nextSection<int32_t>(cursor, end, (size_t)nConfigs + 1);
+	const GainEntry* rowEntries = nextSection<GainEntry>(cursor, end, header->nGainEntries);
+	const int32_t* columnOffsets = nextSection<int32_t>(cursor, end, (size_t)nQueries + 1);
+	const GainEntry* columnEntries = nextSection<GainEntry>(cursor, end, header->nGainEntries);
+	const int32_t* indexOffsets = nextSection<int32_t>(cursor, end, (size_t)nConfigs + 1);
+	const int32_t* indexList = nextSection<int32_t>(cursor, end, header->nIndexEntries);
+
+	// The sections are trusted by all the kernels: check every offset and number before using them
+	checkOffsets(rowOffsets, nConfigs, header->nGainEntries);
+	checkOffsets(columnOffsets, nQueries, header->nGainEntries);
+	checkOffsets(indexOffsets, nConfigs, header->nIndexEntries);
+
+	auto entryId = [](const GainEntry& entry) { return entry.id; };
+	checkIds(rowOffsets, nConfigs, rowEntries, nQueries, entryId);
+	checkIds(columnOffsets, nQueries, columnEntries, nConfigs, entryId);
+	checkIds(indexOffsets, nConfigs, indexList, nIndexes, [](int32_t index) { return (int)index; });
+
+	// No bit beyond the last index, the kernels scan the rows a word at a time
+	if (nIndexes % 64 != 0)
+	{
+		uint64_t unusedBits = ~0ULL << (nIndexes % 64);
+		for (int i = 0; i < nConfigs; i++)
+		{
+			if (bits[(size_t)i * indexWords + indexWords - 1] & unusedBits)
+				throw exception("Error in the binary instance file format: index out of range\n");
+		}
+	}
 
-	// Allocate and read the CONFIGURATION_QUERIES_GAIN
-	configQueriesGain.clear();
-	configQueriesGain.reserve(nConfigs);
-	configServingQueries.clear();
-	configServingQueries.reserve(nQueries);
-	queriesWithGain.clear();
-	queriesWithGain.reserve(nConfigs);
+	// Bulk copy of the sections, no parsing is needed
+	configIndexesBits.assign(bits, bits + (size_t)nConfigs * indexWords);
+	indexesFixedCost.assign(fixedCost, fixedCost + nIndexes);
+	indexesMemoryOccupation.assign(memoryOccupation, memoryOccupation + nIndexes);
+	configGainOffsets.assign(rowOffsets, rowOffsets + nConfigs + 1);
+	configGainEntries.assign(rowEntries, rowEntries + header->nGainEntries);
+	queryGainOffsets.assign(columnOffsets, columnOffsets + nQueries + 1);
+	queryGainEntries.assign(columnEntries, columnEntries + header->nGainEntries);
+
+	configIndexOffsets.assign(indexOffsets, indexOffsets + nConfigs + 1);
+	configIndexList.assign(indexList, indexList + header->nIndexEntries);
+}
 
-	for (int i = 0; i < nQueries; i++)
-		configServingQueries.emplace_back(std::vector<int>());
 
+void Instance::buildAggregates()
+{
+	// Standalone cost and memory of each configuration
+	configFixedCost = vector<long>(nConfigs, 0);
+	configMemory = vector<int>(nConfigs, 0);
 	for (int i = 0; i < nConfigs; i++)
-		queriesWithGain.emplace_back(std::vector<int>());
+	{
+		for (int k : indexesOfConfig(i))
+		{
+			configFixedCost[i] += indexesFixedCost[k];
+			configMemory[i] += indexesMemoryOccupation[k];
+		}
+	}
 
-	for (int i = 0; i < nConfigs; i++) 
+	// Queries that could use each index, sharing its cost in the bounds
+	indexQueries = vector<int>(nIndexes, 0);
+	vector<int> lastQuery(nIndexes, -1);
+	for (int j = 0; j < nQueries; j++)
 	{
-		configQueriesGain.emplace_back(vector<int>(nQueries, 0));
-		for (int j = 0; j < nQueries; j++)
+		for (const GainEntry& entry : configServingQueries(j))
 		{
-			fscanf_s(fl, "%u", &configQueriesGain[i][j]);
+			if (entry.gain <= 0)
+				continue;
 
-			// Count non-zero elements
-			if (configQueriesGain[i][j] > 0) {
-				configServingQueries[j].emplace_back(0);
-				queriesWithGain[i].emplace_back(0);
+			for (int k : indexesOfConfig(entry.id))
+			{
+				if (lastQuery[k] != j)
+					lastQuery[k] = j, indexQueries[k]++;
 			}
 		}
 	}
 
-	fclose(fl);
+	// Columns of the g matrix by decreasing gain, the stable sort keeps the configuration order on ties
+	queryEntriesByGain = queryGainEntries;
+	for (int j = 0; j < nQueries; j++)
+	{
+		std::stable_sort(queryEntriesByGain.begin() + queryGainOffsets[j], queryEntriesByGain.begin() + queryGainOffsets[j + 1],
+			[](const GainEntry& lhs, const GainEntry& rhs) { return lhs.gain > rhs.gain; });
+	}
+}
+
+
+PresolveStats Instance::presolve()
+{
+	using namespace chrono;
+	steady_clock::time_point startTime = steady_clock::now();
+	PresolveStats stats = PresolveStats();
+	vector<bool> keepConfig(nConfigs, true);
+
+	// Configurations with no gain, or that can never be part of a feasible solution
+	for (int i = 0; i < nConfigs; i++)
+	{
+		bool hasGain = false;
+		for (const GainEntry& entry : queriesWithGain(i))
+			hasGain = hasGain || entry.gain > 0;
+
+		if (!hasGain)
+			keepConfig[i] = false, stats.noGainConfigs++;
+		else if (configMemory[i] >= M)
+			keepConfig[i] = false, stats.oversizedConfigs++;
+	}
+
+	// Configurations whose total gain does not exceed the cost of the indexes no other configuration needs:
+	// dropping them from any solution keeps it feasible, and does not decrease its objective value
+	vector<int> indexUsers(nIndexes, 0);
+	for (int i = 0; i < nConfigs; i++)
+	{
+		if (keepConfig[i])
+			for (int k : indexesOfConfig(i))
+				indexUsers[k]++;
+	}
+
+	for (int i = 0; i < nConfigs; i++)
+	{
+		if (!keepConfig[i])
+			continue;
+
+		long totalGain = 0, exclusiveCost = 0;
+		for (const GainEntry& entry : queriesWithGain(i))
+			totalGain += std::max(entry.gain, 0);
+		for (int k : indexesOfConfig(i))
+			exclusiveCost += (indexUsers[k] == 1) ? indexesFixedCost[k] : 0;
+
+		if (totalGain <= exclusiveCost)
+		{
+			keepConfig[i] = false, stats.unprofitableConfigs++;
+			for (int k : indexesOfConfig(i))
+				indexUsers[k]--;
+		}
+	}
+
+	// Dominated configurations, replaceable in any solution by another one without losses:
+	// among identical configurations the lowest numbered is kept
+	for (int i = 0; i < nConfigs; i++)
+	{
+		if (!keepConfig[i])
+			continue;
+
+		for (int j = 0; j < nConfigs; j++)
+		{
+			if (j == i || !keepConfig[j] || !dominates(j, i))
+				continue;
+
+			if (j > i && dominates(i, j))
+				continue;
+
+			keepConfig[i] = false, stats.dominatedConfigs++;
+			break;
+		}
+	}
+
+	int previousIndexes = nIndexes;
+	renumber(keepConfig);
+
+	stats.removedIndexes = previousIndexes - nIndexes;
+	stats.time_ms = duration_cast<microseconds>(steady_clock::now() - startTime).count() / 1000.0;
+	return stats;
+}
+
+
+bool Instance::dominates(int config, int other) const
+{
+	// Cheap necessary conditions first: a subset of the indexes cannot cost more
+	if (configFixedCost[config] > configFixedCost[other] || configMemory[config] > configMemory[other])
+		return false;
+
+	const uint64_t* row = getConfigIndexesRow(config);
+	const uint64_t* otherRow = getConfigIndexesRow(other);
+	for (int w = 0; w < indexWords; w++)
+	{
+		if ((row[w] & ~otherRow[w]) != 0)
+			return false;
+	}
+
+	// Merge of the sorted rows: each gain of other must be matched by a higher or equal gain of config
+	GainList gains = queriesWithGain(config);
+	const GainEntry* it = gains.begin();
+	for (const GainEntry& entry : queriesWithGain(other))
+	{
+		if (entry.gain <= 0)
+			continue;
+
+		while (it != gains.end() && it->id < entry.id)
+			it++;
+		if (it == gains.end() || it->id != entry.id || it->gain < entry.gain)
+			return false;
+	}
+
+	return true;
+}
 
 
-	// Populate the configServingQueries data structure
-	for (int i = 0, k = 0; i < nQueries; i++, k = 0)
+void Instance::renumber(const vector<bool>& keepConfig)
+{
+	// New numbers of the remaining configurations, and of the indexes they require
+	vector<int> newConfigId(nConfigs, -1), newIndexId(nIndexes, -1);
+	vector<int> configIds, indexIds;
+	vector<bool> indexUsed(nIndexes, false);
+	for (int i = 0; i < nConfigs; i++)
 	{
-		for (int j = 0, k = 0; j < nConfigs; j++) {
-			if (configQueriesGain[j][i] > 0)
-				configServingQueries[i][k++] = j;
+		if (!keepConfig[i])
+			continue;
+
+		newConfigId[i] = (int)configIds.size();
+		configIds.emplace_back(i);
+		for (int k : indexesOfConfig(i))
+			indexUsed[k] = true;
+	}
+	for (int k = 0; k < nIndexes; k++)
+	{
+		if (indexUsed[k])
+		{
+			newIndexId[k] = (int)indexIds.size();
+			indexIds.emplace_back(k);
 		}
 	}
 
-	// Populate the queriesWithGain data structure
-	for (int i = 0, k = 0; i < nConfigs; i++, k = 0) 
+	int words = ((int)indexIds.size() + 63) / 64;
+	vector<uint64_t> bits((size_t)configIds.size() * words, 0);
+	vector<int> fixedCost, memoryOccupation, indexOffsets(1, 0), indexList, rowOffsets(1, 0), columnOffsets(nQueries + 1, 0);
+	vector<GainEntry> rowEntries, columnEntries;
+
+	for (int k : indexIds)
+	{
+		fixedCost.emplace_back(indexesFixedCost[k]);
+		memoryOccupation.emplace_back(indexesMemoryOccupation[k]);
+	}
+
+	// Rows of the remaining configurations, the numbering is monotonic so they stay sorted
+	for (int c = 0; c < (int)configIds.size(); c++)
 	{
-		for (int j = 0; j < nQueries; j++) {
-			if (configQueriesGain[i][j] > 0)
-				queriesWithGain[i][k++] = j;
+		for (int k : indexesOfConfig(configIds[c]))
+		{
+			bits[(size_t)c * words + newIndexId[k] / 64] |= (uint64_t)1 << (newIndexId[k] % 64);
+			indexList.emplace_back(newIndexId[k]);
+		}
+		indexOffsets.emplace_back((int)indexList.size());
+
+		for (const GainEntry& entry : queriesWithGain(configIds[c]))
+			rowEntries.emplace_back(entry);
+		rowOffsets.emplace_back((int)rowEntries.size());
+	}
+
+	// Columns, without the removed configurations
+	for (int j = 0; j < nQueries; j++)
+	{
+		for (const GainEntry& entry : configServingQueries(j))
+		{
+			if (newConfigId[entry.id] >= 0)
+				columnEntries.push_back({ newConfigId[entry.id], entry.gain });
 		}
+		columnOffsets[j + 1] = (int)columnEntries.size();
 	}
+
+	// Compose the numberings with the previous ones, in case of repeated presolves
+	for (int& id : configIds)
+		id = originalConfigIds[id];
+	for (int& id : indexIds)
+		id = originalIndexIds[id];
+
+	nConfigs = (int)configIds.size();
+	nIndexes = (int)indexIds.size();
+	indexWords = words;
+	configIndexesBits = std::move(bits);
+	indexesFixedCost = std::move(fixedCost);
+	indexesMemoryOccupation = std::move(memoryOccupation);
+	configGainOffsets = std::move(rowOffsets);
+	configGainEntries = std::move(rowEntries);
+	queryGainOffsets = std::move(columnOffsets);
+	queryGainEntries = std::move(columnEntries);
+	configIndexOffsets = std::move(indexOffsets);
+	configIndexList = std::move(indexList);
+	originalConfigIds = std::move(configIds);
+	originalIndexIds = std::move(indexIds);
+
+	buildAggregates();
+}
+
+
+void Instance::writeBinaryFile(const std::string& fileName) const
+{
+	// The binary format has no room for the original numbering
+	if (nConfigs != originalConfigs || nIndexes != originalIndexes)
+		throw exception("Error: a presolved instance cannot be converted to the binary format");
+
+	FILE* fl;
+	fopen_s(&fl, fileName.c_str(), "wb");
+	if (fl == NULL)
+	{
+		throw exception(("Error: unable to open file '" + fileName + "'").c_str());
+	}
+
+	BinaryInstanceHeader header = BinaryInstanceHeader();
+	memcpy(header.magic, BINARY_INSTANCE_MAGIC, sizeof(header.magic));
+	header.version = BINARY_INSTANCE_VERSION;
+	header.headerSize = sizeof(BinaryInstanceHeader);
+	header.nQueries = nQueries;
+	header.nIndexes = nIndexes;
+	header.nConfigs = nConfigs;
+	header.M = M;
+	header.indexWords = indexWords;
+	header.nGainEntries = (int32_t)configGainEntries.size();
+	header.nIndexEntries = (int32_t)configIndexList.size();
+
+	// Write a data section followed by its alignment padding
+	auto writeSection = [fl](const void* data, size_t bytes) {
+		static const char padding[8] = { 0 };
+		if (bytes > 0) fwrite(data, 1, bytes, fl);
+		fwrite(padding, 1, alignedSize(bytes) - bytes, fl);
+	};
+
+	writeSection(&header, sizeof(header));
+	writeSection(configIndexesBits.data(), configIndexesBits.size() * sizeof(uint64_t));
+	writeSection(indexesFixedCost.data(), indexesFixedCost.size() * sizeof(int32_t));
+	writeSection(indexesMemoryOccupation.data(), indexesMemoryOccupation.size() * sizeof(int32_t));
+	writeSection(configGainOffsets.data(), configGainOffsets.size() * sizeof(int32_t));
+	writeSection(configGainEntries.data(), configGainEntries.size() * sizeof(GainEntry));
+	writeSection(queryGainOffsets.data(), queryGainOffsets.size() * sizeof(int32_t));
+	writeSection(queryGainEntries.data(), queryGainEntries.size() * sizeof(GainEntry));
+	writeSection(configIndexOffsets.data(), configIndexOffsets.size() * sizeof(int32_t));
+	writeSection(configIndexList.data(), configIndexList.size() * sizeof(int32_t));
+
+	bool failed = ferror(fl) != 0;
+	fclose(fl);
+
+	if (failed)
+		throw exception(("Error while writing file '" + fileName + "'").c_str());
+}
+
+
+int Instance::getGain(int config, int query) const
+{
+	if (config < 0 || config >= nConfigs)		// No configuration, no gain
+		return 0;
+
+	GainList row = queriesWithGain(config);
+
+	// Search of the query inside the sorted configuration row
+	return findGain(row.begin(), (int)row.size(), query);
 }
 
 
 /****	SOLUTION CLASS	****/
 
 
-Solution::Solution(Instance& probInst)
+Solution::Solution(Instance& probInst, std::pmr::memory_resource* genomeStorage)
 	: objFunctionValue(0),
 	fitnessValue(0),
+	totalGain(0),
+	totalCost(0),
 	memory(0),
 	problemInstance(probInst),
-	selectedConfigurations(vector<short>(probInst.nQueries, -1)),		// Initialize default solution
-	indexesToBuild(vector<short>(probInst.nIndexes, 0))
+	selectedConfigurations(probInst.nQueries, -1, genomeStorage),		// Initialize default solution
+	indexesUsage(vector<int>(probInst.nIndexes, 0)),
+	builtIndexes(vector<uint64_t>(probInst.indexWords, 0)),
+	indexesStale(false),
+	genomeHash(0)
 {	
 }
 
@@ -183,9 +1080,14 @@ Solution::Solution(const Solution& other)
 	: problemInstance(other.problemInstance),
 	objFunctionValue(other.objFunctionValue),
 	fitnessValue(other.fitnessValue),
+	totalGain(other.totalGain),
+	totalCost(other.totalCost),
 	memory(other.memory),
 	selectedConfigurations(other.selectedConfigurations),
-	indexesToBuild(vector<short>(other.problemInstance.nIndexes, 0))
+	indexesUsage(other.indexesUsage),
+	builtIndexes(other.builtIndexes),
+	indexesStale(other.indexesStale),
+	genomeHash(other.genomeHash)
 {
 }
 
@@ -193,12 +1095,21 @@ Solution& Solution::operator=(const Solution& other)
 {
 	if (this != &other)
 	{
-		this->problemInstance = other.problemInstance;
 		this->objFunctionValue = other.objFunctionValue;
 		this->fitnessValue = other.fitnessValue;
+		this->totalGain = other.totalGain;
+		this->totalCost = other.totalCost;
 		this->memory = other.memory;
 		this->selectedConfigurations = other.selectedConfigurations;
-		this->indexesToBuild = vector<short>(problemInstance.nIndexes, 0);
+		this->indexesStale = other.indexesStale;
+		this->genomeHash = other.genomeHash;
+
+		// Stale indexes are rebuilt from the genome anyway, there is no need to copy them
+		if (!other.indexesStale)
+		{
+			this->indexesUsage = other.indexesUsage;
+			this->builtIndexes = other.builtIndexes;
+		}
 	}
 
 	return *this;
@@ -209,73 +1120,259 @@ Solution::~Solution()
 }
 
 
-long int Solution::evaluate() 
+void Solution::reset()
 {
-	int all_gains = 0;
-	int time_spent = 0;
+	std::fill(selectedConfigurations.begin(), selectedConfigurations.end(), -1);
+	std::fill(indexesUsage.begin(), indexesUsage.end(), 0);
+	std::fill(builtIndexes.begin(), builtIndexes.end(), 0);
+	indexesStale = false;
+	genomeHash = 0;
+
+	objFunctionValue = 0;
+	fitnessValue = 0;
+	totalGain = 0;
+	totalCost = 0;
 	memory = 0;
+}
 
-	std::fill(indexesToBuild.begin(), indexesToBuild.end(), 0);
 
-	// Calculate the gains and costs of the selected configurations
+long int Solution::evaluate(EvaluationCache* cache)
+{
+	// Genomes already evaluated by the thread take their scores from its cache
+	if (cache != nullptr && lookupScores(*cache))
+		return objFunctionValue;
+
+	buildIndexes();
+
+	// Calculate the gains of the selected configurations
+	totalGain = 0;
 	for (int i = 0; i < problemInstance.nQueries; i++) 
 	{
-		if (selectedConfigurations[i] < 0)
-			continue;
+		if (selectedConfigurations[i] >= 0)
+			totalGain += problemInstance.getGain(selectedConfigurations[i], i);
+	}
+
+	updateScores();
+
+	if (cache != nullptr)
+		cache->store(genomeHash, totalGain, totalCost, memory);
+
+	return objFunctionValue;
+}
+
 
-		for (int k = 0; k < problemInstance.nIndexes; k++) 
+void Solution::evaluateBatch(Solution* const batch[], int size, WorkPool* pool, EvaluationCache* cache)
+{
+	if (cache != nullptr)
+	{
+		// The cache is accessed only by the calling thread, the helper threads evaluate just the misses
+		vector<Solution*> misses;
+		for (int s = 0; s < size; s++)
 		{
-			// If index k is part of configuration i and has not yet been built
-			if (problemInstance.configIndexesMatrix[selectedConfigurations[i]][k] == 1 && indexesToBuild[k] == 0) 
-			{
-				indexesToBuild[k] = 1;										// Mark it as 'used'
-				time_spent += problemInstance.indexesFixedCost[k];			// Add its time...
-				memory += problemInstance.indexesMemoryOccupation[k];		// ...and memory cost
-			}
+			if (!batch[s]->lookupScores(*cache))
+				misses.push_back(batch[s]);
 		}
-		// Add the gain of the chosen configuration for the current query
-		all_gains += problemInstance.configQueriesGain[selectedConfigurations[i]][i];
+
+		evaluateBatch(misses.data(), (int)misses.size(), pool);
+
+		for (Solution* sol : misses)
+			cache->store(sol->genomeHash, sol->totalGain, sol->totalCost, sol->memory);
+		return;
 	}
 
-	// Feasibility (memory constraint)
-	bool feasible = memory < problemInstance.M;
+	// Small batches are not worth the synchronization with the helper threads
+	if (pool == nullptr || size <= EVALUATION_BATCH_WIDTH)
+	{
+		for (int first = 0; first < size; first += EVALUATION_BATCH_WIDTH)
+			evaluateGroup(batch + first, std::min(EVALUATION_BATCH_WIDTH, size - first));
+		return;
+	}
 
-	// Objective function (total gains - index cost)
-	objFunctionValue = feasible ? all_gains - time_spent : LONG_MIN;
+	pool->parallelFor(0, size, EVALUATION_BATCH_WIDTH, [batch](int first, int last) {
+		evaluateGroup(batch + first, last - first);
+	});
+}
 
-	// Fitness function = objective function (+ penalty)
-	fitnessValue = (all_gains - time_spent) -
-		(feasible ? 0 : (memory - problemInstance.M));		// Penalise infeasible solutions by their surplus memory
 
+void Solution::evaluateGroup(Solution* const group[], int size)
+{
+	const Instance& inst = group[0]->problemInstance;
 
-	return objFunctionValue;
+	for (int s = 0; s < size; s++)
+	{
+		std::fill(group[s]->indexesUsage.begin(), group[s]->indexesUsage.end(), 0);
+		std::fill(group[s]->builtIndexes.begin(), group[s]->builtIndexes.end(), 0);
+		group[s]->totalGain = 0;
+		group[s]->genomeHash = 0;
+		group[s]->indexesStale = false;
+	}
+
+	// Walk the queries once for the whole group, so that the index rows and gains
+	// of the configurations shared by similar solutions are read from the cache
+	for (int i = 0; i < inst.nQueries; i++)
+	{
+		for (int s = 0; s < size; s++)
+		{
+			Solution& sol = *group[s];
+			int config = sol.selectedConfigurations[i];
+			if (config < 0)
+				continue;
+
+			orBits(sol.builtIndexes.data(), inst.getConfigIndexesRow(config), inst.indexWords);
+			for (int k : inst.indexesOfConfig(config))
+				sol.indexesUsage[k]++;
+			sol.totalGain += inst.getGain(config, i);
+			sol.genomeHash ^= geneHash(i, (short)config);
+		}
+	}
+
+	for (int s = 0; s < size; s++)
+	{
+		Solution& sol = *group[s];
+		sol.totalCost = sumOverBits(sol.builtIndexes.data(), inst.indexWords, inst.indexesFixedCost.data());
+		sol.memory = (int)sumOverBits(sol.builtIndexes.data(), inst.indexWords, inst.indexesMemoryOccupation.data());
+		sol.updateScores();
+	}
 }
 
 
 int Solution::evaluateMemory()
 {
-	memory = 0;
-	std::fill(indexesToBuild.begin(), indexesToBuild.end(), 0);
+	buildIndexes();
 
-	// Calculate memory cost of the solution
+	return memory;
+}
+
+
+void Solution::buildIndexes()
+{
+	std::fill(indexesUsage.begin(), indexesUsage.end(), 0);
+	std::fill(builtIndexes.begin(), builtIndexes.end(), 0);
+	genomeHash = 0;
+
+	// Combine the index rows of all the selected configurations
 	for (int i = 0; i < problemInstance.nQueries; i++)
 	{
 		if (selectedConfigurations[i] < 0)
 			continue;
 
-		// Find all the indexes that are required by the selected configuration
-		for (int k = 0; k < problemInstance.nIndexes; k++) 
+		orBits(builtIndexes.data(), problemInstance.getConfigIndexesRow(selectedConfigurations[i]), problemInstance.indexWords);
+		for (int k : problemInstance.indexesOfConfig(selectedConfigurations[i]))
+			indexesUsage[k]++;
+		genomeHash ^= geneHash(i, selectedConfigurations[i]);
+	}
+	indexesStale = false;
+
+	// Sum the time and memory costs of the indexes to build
+	totalCost = sumOverBits(builtIndexes.data(), problemInstance.indexWords, problemInstance.indexesFixedCost.data());
+	memory = (int)sumOverBits(builtIndexes.data(), problemInstance.indexWords, problemInstance.indexesMemoryOccupation.data());
+}
+
+
+bool Solution::lookupScores(EvaluationCache& cache)
+{
+	genomeHash = 0;
+	for (int i = 0; i < problemInstance.nQueries; i++)
+	{
+		if (selectedConfigurations[i] >= 0)
+			genomeHash ^= geneHash(i, selectedConfigurations[i]);
+	}
+
+	EvaluationCache::Entry entry;
+	if (!cache.lookup(genomeHash, entry))
+		return false;
+
+	totalGain = entry.totalGain;
+	totalCost = entry.totalCost;
+	memory = entry.memory;
+	indexesStale = true;
+	updateScores();
+
+	return true;
+}
+
+
+uint64_t Solution::geneHash(int query, short config)
+{
+	// SplitMix64 step of the (query, configuration) pair, the genome hash is the XOR over its genes; the odd increment
+	// keeps the pair (0, 0) from hashing to 0, which would make it vanish from the genome hash
+	uint64_t x = (((uint64_t)query << 16) | (uint16_t)config) + 0x9E3779B97F4A7C15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+
+void Solution::setConfiguration(int query, short config)
+{
+	short previous = selectedConfigurations[query];
+	if (previous == config)
+		return;
+
+	// Scores taken from the cache, the index usage has to be rebuilt before updating it
+	if (indexesStale)
+		buildIndexes();
+
+	// Only the indexes of the previous and of the new configuration can change their status
+	if (previous >= 0)
+	{
+		deactivateConfiguration(previous);
+		totalGain -= problemInstance.getGain(previous, query);
+		genomeHash ^= geneHash(query, previous);
+	}
+	if (config >= 0)
+	{
+		activateConfiguration(config);
+		totalGain += problemInstance.getGain(config, query);
+		genomeHash ^= geneHash(query, config);
+	}
+
+	selectedConfigurations[query] = config;
+	updateScores();
+}
+
+
+void Solution::activateConfiguration(int config)
+{
+	for (int k : problemInstance.indexesOfConfig(config))
+	{
+		// If index k has not yet been built, add its time and memory cost
+		if (indexesUsage[k]++ == 0)
 		{
-			// If index k belongs to configuration i and has not yet been built
-			if (problemInstance.configIndexesMatrix[selectedConfigurations[i]][k] == 1 && indexesToBuild[k] == 0)
-			{
-				indexesToBuild[k] = 1;										// Mark it as 'used'
-				memory += problemInstance.indexesMemoryOccupation[k];		// and add its memory cost to the result
-			}
+			builtIndexes[k / 64] |= (uint64_t)1 << (k % 64);
+			totalCost += problemInstance.indexesFixedCost[k];
+			memory += problemInstance.indexesMemoryOccupation[k];
 		}
 	}
+}
 
-	return memory;
+
+void Solution::deactivateConfiguration(int config)
+{
+	for (int k : problemInstance.indexesOfConfig(config))
+	{
+		// If no other selected configuration requires index k, it does not have to be built anymore
+		if (--indexesUsage[k] == 0)
+		{
+			builtIndexes[k / 64] &= ~((uint64_t)1 << (k % 64));
+			totalCost -= problemInstance.indexesFixedCost[k];
+			memory -= problemInstance.indexesMemoryOccupation[k];
+		}
+	}
+}
+
+
+void Solution::updateScores()
+{
+	// Feasibility (memory constraint)
+	bool feasible = memory < problemInstance.M;
+
+	// Objective function (total gains - index cost)
+	objFunctionValue = feasible ? totalGain - totalCost : LONG_MIN;
+
+	// Fitness function = objective function (+ penalty)
+	fitnessValue = (totalGain - totalCost) -
+		(feasible ? 0 : (memory - problemInstance.M));		// Penalise infeasible solutions by their surplus memory
 }
 
 
@@ -294,36 +1391,71 @@ int Solution::getMemoryCost() const
 	return memory;
 }
 
-
-void Solution::writeToFile(const std::string& fileName) const
+uint64_t Solution::getGenomeHash() const
 {
-	std::vector<std::vector<short int>> configsServingQueries;
-
-	// Generate solution matrix on-the-fly before printing it
-	for (int i = 0; i < problemInstance.nQueries; i++)
-	{
-		configsServingQueries.emplace_back(std::vector<short int>(problemInstance.nConfigs, 0));
+	return genomeHash;
+}
 
-		// Set value of the proper cell of the column
-		if (selectedConfigurations[i] >= 0)
-			configsServingQueries[i][selectedConfigurations[i]] = 1;
-	}
 
+void Solution::writeToFile(const std::string& fileName, bool sparse) const
+{
 	FILE* fl;
 	fopen_s(&fl, fileName.c_str(), "w");
 	if (fl == NULL)
 	{
 		throw exception(("Error: unable to open file '" + fileName + "'").c_str());
 	}
+
+	if (sparse)
+	{	// Print a "<query> <configuration>" line for each served query
+		for (int i = 0; i < problemInstance.nQueries; i++)
+		{
+			if (selectedConfigurations[i] >= 0)
+				fprintf_s(fl, "%d %d\n", i, problemInstance.originalConfigIds[selectedConfigurations[i]]);
+		}
+	}
 	else
-	{	// Print the solution matrix on the output file
-		for (int i = 0; i < problemInstance.nConfigs; i++) 
+	{
+		// Group the served queries by configuration (counting sort), to generate the solution matrix row by row,
+		// with all the configurations of the input file
+		const vector<int>& configIds = problemInstance.originalConfigIds;
+		std::vector<int> rowOffsets(problemInstance.originalConfigs + 1, 0);
+		std::vector<int> rowQueries(problemInstance.nQueries);
+		for (int i = 0; i < problemInstance.nQueries; i++)
 		{
-			for (int j = 0; j < problemInstance.nQueries; j++) {
-				fprintf_s(fl, "%d ", configsServingQueries[j][i]);
-			}
-			fprintf_s(fl, "\n");
+			if (selectedConfigurations[i] >= 0)
+				rowOffsets[configIds[selectedConfigurations[i]] + 1]++;
+		}
+		for (int i = 0; i < problemInstance.originalConfigs; i++)
+			rowOffsets[i + 1] += rowOffsets[i];
+		std::vector<int> position(rowOffsets.begin(), rowOffsets.end() - 1);
+		for (int i = 0; i < problemInstance.nQueries; i++)
+		{
+			if (selectedConfigurations[i] >= 0)
+				rowQueries[position[configIds[selectedConfigurations[i]]]++] = i;
+		}
+
+		// Print the solution matrix on the output file, formatting each row in a buffer
+		std::string row(2 * problemInstance.nQueries + 1, ' ');
+		for (int j = 0; j < problemInstance.nQueries; j++)
+			row[2 * j] = '0';
+		row.back() = '\n';
+
+		for (int i = 0; i < problemInstance.originalConfigs; i++) 
+		{
+			for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; k++)
+				row[2 * rowQueries[k]] = '1';
+
+			fwrite(row.data(), 1, row.size(), fl);
+
+			for (int k = rowOffsets[i]; k < rowOffsets[i + 1]; k++)
+				row[2 * rowQueries[k]] = '0';
 		}
-		fclose(fl);
 	}
+
+	bool failed = ferror(fl) != 0;
+	fclose(fl);
+
+	if (failed)
+		throw exception(("Error while writing file '" + fileName + "'").c_str());
 }
@@ -2,17 +2,62 @@
 
 #include <string>
 #include <vector>
+#include <memory_resource>
+#include <cstdint>
+#include <climits>
 
 #define DEFAULT_TIMELIMIT 180*1000	// ms
+#define DEFAULT_THREADS 2			// Used when the number of hardware threads cannot be detected
+#define DEFAULT_MIGRATION_INTERVAL 100		// Generations
+#define EVALUATION_BATCH_WIDTH 8		// Solutions evaluated together in a single pass over the queries
+#define DEFAULT_SUMMARY_FILE "batch_summary.txt"
+#define DEFAULT_BENCHMARK_INSTANCES "instances"		// Directory of the bundled instances
+#define DEFAULT_BENCHMARK_PREFIX "benchmark"
+#define DEFAULT_REGRESSION_TOLERANCE 5				// Percent
 
 using namespace std;
 
+class WorkPool;
+class EvaluationCache;
+
+typedef std::pmr::vector<short> Genome;		// Genes of a solution, on the heap or in the genome buffer of a SolutionPool slab
+struct GainEntry;
+
+enum KernelType { KERNEL_AUTO, KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512 };		// Implementations of the evaluation kernels
+enum AlgorithmType { ALGORITHM_GENETIC, ALGORITHM_BRANCH_AND_BOUND };			// Search engines
 
 typedef struct Params		// Wrapper structure used to hold command line execution parameters
 {
 	string inputFileName = string();
 	string outputFileName = string();				// Generated as <inputFileName>_OMAAL_group04.sol
-	unsigned int timeLimit = DEFAULT_TIMELIMIT;
+	string binaryFileName = string();				// Set only when converting the instance to the binary format (-c)
+	unsigned int timeLimit = DEFAULT_TIMELIMIT;		// ms
+	unsigned int nThreads = DEFAULT_THREADS;		// Worker threads, hardware concurrency unless set with -j
+	unsigned int migrationInterval = DEFAULT_MIGRATION_INTERVAL;	// Generations between island migrations (0 = isolated islands)
+	bool randomMigrationTopology = false;			// Islands connected in a random ring instead of in thread order
+	bool sparseOutput = false;						// Solution written as query-configuration pairs instead of the dense matrix
+	unsigned int evaluationThreads = 0;				// Helper threads for the batched evaluations (0 = evaluate on the worker threads)
+	KernelType kernels = KERNEL_AUTO;				// Evaluation kernels, the best supported by the CPU unless forced with --kernel
+	bool presolve = true;							// Instance reduction before the search, disabled with --no-presolve
+	AlgorithmType algorithm = ALGORITHM_GENETIC;	// Search engine, selected with --algorithm
+	double targetGap = -1;							// Optimality gap (%) at which the search stops, set with --gap (negative = disabled)
+	long targetObjective = LONG_MAX;				// Objective function value at which the search stops, set with --target
+	bool fixedSeed = false;							// Random numbers derived from --seed, for reproducible runs
+	uint64_t seed = 0;
+	unsigned long long generationBudget = 0;		// Generations after which the islands stop, set with --generations (0 = no budget)
+	unsigned long long evaluationBudget = 0;		// Solutions actually scored (see SearchStatistics) after which the islands stop, set with --evaluations (0 = no budget)
+	string batchPath = string();					// Directory or manifest of the instances solved in batch mode (--batch)
+	unsigned int batchJobs = 0;						// Instances solved at the same time in batch mode (0 = one per thread)
+	string summaryFileName = string(DEFAULT_SUMMARY_FILE);		// Table of the batch results
+	unsigned int benchmarkRuns = 0;					// Runs of each instance and time limit in benchmark mode (--benchmark, 0 = plain batch)
+	vector<unsigned int> benchmarkBudgets;			// Time limits (ms) of the benchmark runs, those of the batch if empty (--budgets)
+	string benchmarkPrefix = string(DEFAULT_BENCHMARK_PREFIX);	// Prefix of the benchmark result files (--bench-output)
+	string baselineFileName = string();				// Summary of a previous benchmark to compare with (--baseline)
+	double regressionTolerance = DEFAULT_REGRESSION_TOLERANCE;	// Loss of quality or throughput (%) flagged as a regression (--tolerance)
+	unsigned int statsInterval = 0;					// ms between the live reports of the thread counters (--stats, 0 = disabled)
+	bool statsJson = false;							// Reports as JSON lines instead of text (--stats-format)
+	string statsFileName = string();				// File of the reports, stdout if empty (--stats-output)
+	bool verbose = true;							// Progress messages of the engines, turned off in batch mode
 } Parameters;
 
 
@@ -20,12 +65,108 @@ typedef struct Params		// Wrapper structure used to hold command line execution
 
 
 Parameters parseCommandLine(int argc, char* argv[]);
+unsigned int parseTimeLimit(const char* text);		// Time limit in ms, from seconds (optionally with the 's' suffix) or from milliseconds with the 'ms' suffix
 long long getCurrentTime_ms();
+uint64_t deriveSeed(uint64_t seed, uint64_t stream);		// Independent seed for each stream of random numbers of a seeded run
+
+// Evaluation kernels, called through pointers to the implementation chosen by selectKernels()
+extern void (*orBits)(uint64_t* dst, const uint64_t* src, int words);								// dst |= src, on rows of 64-bit words
+extern long (*sumOverBits)(const uint64_t* bits, int words, const int* values);					// Sum of values[k] for each bit k set
+extern long (*sumOverNewBits)(const uint64_t* row, const uint64_t* mask, int words, const int* values);	// Same, for bits set in row but not in mask
+extern int (*findGain)(const GainEntry* entries, int size, int id);		// Gain of the entry with the given id in a sorted list, 0 if missing
+
+KernelType selectKernels(KernelType requested);		// Installs the requested kernels (or the best supported ones) and returns them
+const char* getKernelName(KernelType kernels);
 
 
 /* ============= CLASSES ============= */
 
 
+struct GainEntry		// Non-zero element of the g matrix, stored inside a sparse row or column
+{
+	int id;			// Query (in a configuration row) or configuration (in a query column)
+	int gain;
+};
+
+
+class GainList		// Read-only view over a contiguous range of GainEntry elements
+{
+
+private:
+
+	const GainEntry* first;
+	const GainEntry* last;
+
+public:
+
+	GainList(const GainEntry* begin, const GainEntry* end) : first(begin), last(end) { };
+
+	const GainEntry* begin() const { return first; }
+	const GainEntry* end() const { return last; }
+	size_t size() const { return last - first; }
+	const GainEntry& operator[](size_t i) const { return first[i]; }
+
+};
+
+
+class IndexList		// Read-only view over a contiguous range of index numbers
+{
+
+private:
+
+	const int* first;
+	const int* last;
+
+public:
+
+	IndexList(const int* begin, const int* end) : first(begin), last(end) { };
+
+	const int* begin() const { return first; }
+	const int* end() const { return last; }
+	size_t size() const { return last - first; }
+	int operator[](size_t i) const { return first[i]; }
+
+};
+
+
+class MappedFile		// Read-only memory mapping of an entire file
+{
+
+private:
+
+	const char* mappedData;
+	size_t mappedSize;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+public:
+
+	MappedFile(const std::string& fileName);
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+	~MappedFile();
+
+	const char* data() const { return mappedData; }
+	size_t size() const { return mappedSize; }
+
+};
+
+
+struct PresolveStats		// Outcome of Instance::presolve()
+{
+	int noGainConfigs;			// Configurations serving no query
+	int oversizedConfigs;		// Configurations whose indexes alone exceed the memory
+	int unprofitableConfigs;	// Configurations whose gains cannot repay the indexes used only by them
+	int dominatedConfigs;		// Configurations with a subset of the indexes of another one, and no higher gains
+	int removedIndexes;			// Indexes not required by any remaining configuration
+	double time_ms;
+};
+
+
 class Instance		// Holds the input dataset of the problem instance
 {
 
@@ -35,14 +176,34 @@ public:
 	int nIndexes;		// |I|
 	int nConfigs;		// |C|
 	int M;				// Memory
+	int indexWords;		// 64-bit words in each row of the e matrix
 
-	vector<vector<short>> configIndexesMatrix;	 // e matrix
+	vector<uint64_t> configIndexesBits;			 // e matrix, one contiguous bitset row per configuration
 	vector<int> indexesFixedCost;				 // f vector
 	vector<int> indexesMemoryOccupation;		 // m vector
-	vector<vector<int>> configQueriesGain;		 // g matrix
 
-	vector<vector<int>> configServingQueries;	 // #Queries vectors  
-	vector<vector<int>> queriesWithGain;		 // #Configuration vectors
+	vector<int> configGainOffsets;				 // g matrix rows in CSR format: (query, gain) pairs of each configuration
+	vector<GainEntry> configGainEntries;
+	vector<int> queryGainOffsets;				 // g matrix columns in CSC format: (configuration, gain) pairs of each query
+	vector<GainEntry> queryGainEntries;
+
+	vector<int> configIndexOffsets;				 // Indexes required by each configuration, as adjacency lists in CSR format
+	vector<int> configIndexList;
+
+	// Aggregates derived at load time, read-only afterwards
+	vector<long> configFixedCost;				 // Total cost of the indexes of each configuration, built on their own
+	vector<int> configMemory;					 // Total memory of the indexes of each configuration
+	vector<int> indexQueries;					 // Number of queries served with a gain by some configuration requiring each index
+	vector<GainEntry> queryEntriesByGain;		 // g matrix columns, with the same offsets as queryGainEntries, sorted by decreasing gain
+
+	// Numbering of the input file, the presolve renumbers the remaining configurations and indexes
+	int originalConfigs;
+	int originalIndexes;
+	vector<int> originalConfigIds;				 // Input number of each configuration
+	vector<int> originalIndexIds;				 // Input number of each index
+
+	size_t inputBytes;		// Size of the input file
+	double inputTime_ms;	// Time spent reading the input file
 
 
 public:
@@ -50,7 +211,47 @@ public:
 	Instance();
 	~Instance();
 
-	void readInputFile(const std::string& fileName);	// Instance input
+	void readInputFile(const std::string& fileName);	// Instance input, in text (.odbdp) or binary format
+	void writeBinaryFile(const std::string& fileName) const;
+	PresolveStats presolve();		// Removes the configurations and indexes that cannot improve the optimal solution
+
+	const uint64_t* getConfigIndexesRow(int config) const { return configIndexesBits.data() + (size_t)config * indexWords; }
+
+	GainList queriesWithGain(int config) const		// Queries that get a gain from the configuration, sorted by query
+	{
+		return GainList(configGainEntries.data() + configGainOffsets[config], configGainEntries.data() + configGainOffsets[config + 1]);
+	}
+
+	GainList configServingQueries(int query) const	// Configurations that provide a gain to the query, sorted by configuration
+	{
+		return GainList(queryGainEntries.data() + queryGainOffsets[query], queryGainEntries.data() + queryGainOffsets[query + 1]);
+	}
+
+	IndexList indexesOfConfig(int config) const		// Indexes required by the configuration, in increasing order
+	{
+		return IndexList(configIndexList.data() + configIndexOffsets[config], configIndexList.data() + configIndexOffsets[config + 1]);
+	}
+
+	GainList configsByGain(int query) const		// Configurations that provide a gain to the query, highest gain first
+	{
+		return GainList(queryEntriesByGain.data() + queryGainOffsets[query], queryEntriesByGain.data() + queryGainOffsets[query + 1]);
+	}
+
+	int bestConfigForQuery(int query) const		// Configuration with the highest gain for the query (lowest number on ties), -1 if none
+	{
+		int first = queryGainOffsets[query];
+		return (first < queryGainOffsets[query + 1] && queryEntriesByGain[first].gain > 0) ? queryEntriesByGain[first].id : -1;
+	}
+
+	int getGain(int config, int query) const;		// Element of the g matrix, searched in the configuration row (0 for no configuration)
+
+private:
+
+	void readTextFile(const MappedFile& file);
+	void readBinaryFile(const MappedFile& file);
+	void buildAggregates();
+	bool dominates(int config, int other) const;
+	void renumber(const vector<bool>& keepConfig);
 
 };
 
@@ -61,31 +262,51 @@ class Solution		// Represent a possible solution for the given problem
 
 public:
 
-	vector<short> selectedConfigurations;		// Compact integer representation of the solution matrix
+	Genome selectedConfigurations;				// Compact integer representation of the solution matrix
+												// (direct writes must be followed by evaluate(), setConfiguration() keeps it consistent)
 
 private:
 
-	vector<short> indexesToBuild;			// b vector
+	vector<int> indexesUsage;				// Number of selected configurations requiring each index
+	vector<uint64_t> builtIndexes;			// b vector, bitset of the indexes to build
+	bool indexesStale;						// Scores taken from an EvaluationCache, indexes rebuilt only when needed
+	uint64_t genomeHash;					// Hash of selectedConfigurations, as of the last evaluation or setConfiguration()
 	Instance& problemInstance;
 		
 	long objFunctionValue;
 	long fitnessValue;
+	long totalGain;
+	long totalCost;
 	int memory;
 
 
 public:
 
-	Solution(Instance& probInst);					// Constructs an empty feasible Solution for the problem Instance
+	Solution(Instance& probInst, std::pmr::memory_resource* genomeStorage = std::pmr::get_default_resource());		// Constructs an empty feasible Solution for the problem Instance
 	Solution(const Solution& other);				// Copy constructor
-	Solution& operator=(const Solution& other);		// Copy-assignment operator
+	Solution& operator=(const Solution& other);		// Copy-assignment operator, between solutions of the same Instance
 	~Solution();
 
-	long evaluate();
+	void reset();									// Restores the empty default solution
+	long evaluate(EvaluationCache* cache = nullptr);
 	int evaluateMemory();
+	static void evaluateBatch(Solution* const batch[], int size, WorkPool* pool = nullptr, EvaluationCache* cache = nullptr);	// Full evaluation of many solutions of the same Instance
+	void setConfiguration(int query, short config);		// Incremental update of a single gene and of the solution scores
 	long getObjFunctionValue() const;
 	long getFitnessValue() const;
 	int getMemoryCost() const;
+	uint64_t getGenomeHash() const;
+
+	void writeToFile(const std::string& fileName, bool sparse = false) const;	// Solution output, as dense matrix or as query-configuration pairs
+
+private:
 
-	void writeToFile(const std::string& fileName) const;	// Solution output
+	void buildIndexes();
+	bool lookupScores(EvaluationCache& cache);
+	static uint64_t geneHash(int query, short config);
+	static void evaluateGroup(Solution* const group[], int size);
+	void activateConfiguration(int config);
+	void deactivateConfiguration(int config);
+	void updateScores();
 	
 };
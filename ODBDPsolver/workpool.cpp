@@ -0,0 +1,160 @@
+#include "workpool.hpp"
+
+
+static thread_local const WorkPool* currentPool = nullptr;		// Pool owning the current thread, if any
+static thread_local int currentWorker = -1;
+
+
+WorkPool::WorkPool(unsigned int nWorkers)
+	: nextQueue(0), queuedTasks(0), stopping(false)
+{
+	if (nWorkers == 0)
+		nWorkers = 1;
+
+	for (unsigned int i = 0; i < nWorkers; i++)
+		queues.emplace_back(new WorkerQueue());
+
+	for (unsigned int i = 0; i < nWorkers; i++)
+		workers.emplace_back(&WorkPool::workerLoop, this, (int)i);
+}
+
+WorkPool::~WorkPool()
+{
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+
+	for (thread& worker : workers)
+		worker.join();
+}
+
+
+void WorkPool::submit(Task task, TaskGroup* group)
+{
+	if (group != nullptr)
+	{
+		group->pendingTasks++;
+
+		// Decrease the group counter once the task has been executed, even if it throws:
+		// the exception is kept for wait(), which would never return otherwise
+		task = [task = std::move(task), group]() {
+			try {
+				task();
+			}
+			catch (...) {
+				lock_guard<mutex> lock(group->errorMutex);
+				if (!group->error)
+					group->error = current_exception();
+			}
+			group->pendingTasks--;
+		};
+	}
+
+	// Workers push on their own deque, other threads spread the tasks over all of them
+	int index = (currentPool == this) ? currentWorker : (int)(nextQueue++ % queues.size());
+	{
+		lock_guard<mutex> lock(queues[index]->mtx);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+
+	{
+		lock_guard<mutex> lock(sleepMutex);
+		queuedTasks++;
+	}
+	wakeUp.notify_one();
+}
+
+
+void WorkPool::wait(TaskGroup& group)
+{
+	int index = (currentPool == this) ? currentWorker : -1;
+
+	// Help with the queued work instead of blocking
+	while (group.pendingTasks.load() > 0)
+	{
+		if (!runTask(index))
+			this_thread::yield();
+	}
+
+	// All the tasks have completed, report the first failure to the caller
+	exception_ptr error;
+	{
+		lock_guard<mutex> lock(group.errorMutex);
+		std::swap(error, group.error);
+	}
+	if (error)
+		rethrow_exception(error);
+}
+
+
+void WorkPool::parallelFor(int begin, int end, int grain, const function<void(int, int)>& body)
+{
+	TaskGroup group;
+
+	if (grain < 1)
+		grain = 1;
+
+	for (int first = begin; first < end; first += grain)
+	{
+		int last = (end - first > grain) ? first + grain : end;
+		submit([&body, first, last]() { body(first, last); }, &group);
+	}
+
+	wait(group);
+}
+
+
+void WorkPool::workerLoop(int index)
+{
+	currentPool = this;
+	currentWorker = index;
+
+	while (true)
+	{
+		if (runTask(index))
+			continue;
+
+		unique_lock<mutex> lock(sleepMutex);
+		wakeUp.wait(lock, [this] { return queuedTasks.load() > 0 || stopping; });
+
+		if (stopping && queuedTasks.load() == 0)
+			break;
+	}
+}
+
+
+bool WorkPool::runTask(int index)
+{
+	Task task;
+	int nQueues = (int)queues.size();
+
+	// Own tasks are taken from the back (most recent first), stolen ones from the front (oldest first)
+	for (int k = 0; k < nQueues && !task; k++)
+	{
+		int victim = (index < 0) ? k : (index + k) % nQueues;
+		WorkerQueue& queue = *queues[victim];
+
+		lock_guard<mutex> lock(queue.mtx);
+		if (queue.tasks.empty())
+			continue;
+
+		if (victim == index) {
+			task = std::move(queue.tasks.back());
+			queue.tasks.pop_back();
+		}
+		else {
+			task = std::move(queue.tasks.front());
+			queue.tasks.pop_front();
+		}
+	}
+
+	if (!task)
+		return false;
+
+	queuedTasks--;
+	task();
+
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+using namespace std;
+
+
+/*
+** WorkPool is a pool of worker threads with one task deque each: workers pop their own tasks from the back
+** and steal from the front of the other deques when they run out of work, so uneven tasks get balanced.
+** Threads outside the pool can submit tasks and help executing them while they wait for their completion
+*/
+class WorkPool
+{
+
+public:
+
+	typedef function<void()> Task;
+
+	// Counter of the pending tasks submitted together, used to wait for their completion,
+	// and the first exception thrown by one of them
+	class TaskGroup
+	{
+		friend class WorkPool;
+		atomic<int> pendingTasks;
+		mutex errorMutex;
+		exception_ptr error;
+	public:
+		TaskGroup() : pendingTasks(0) { };
+	};
+
+private:
+
+	struct alignas(64) WorkerQueue {
+		mutex mtx;
+		deque<Task> tasks;
+	};
+
+	vector<unique_ptr<WorkerQueue>> queues;
+	vector<thread> workers;
+	atomic<unsigned int> nextQueue;		// Round-robin target for the tasks submitted from outside the pool
+	atomic<int> queuedTasks;
+	atomic<bool> stopping;
+	mutex sleepMutex;
+	condition_variable wakeUp;
+
+
+public:
+
+	WorkPool(unsigned int nWorkers);
+	WorkPool(const WorkPool& other) = delete;
+	WorkPool& operator=(const WorkPool& other) = delete;
+	~WorkPool();
+
+	void submit(Task task, TaskGroup* group = nullptr);
+	void wait(TaskGroup& group);		// Executes queued tasks until all the tasks of the group have completed, then rethrows their first exception
+
+	// Splits [begin, end) in chunks of at most grain elements, runs body(first, last) on each of them and waits
+	void parallelFor(int begin, int end, int grain, const function<void(int, int)>& body);
+
+	unsigned int size() const { return (unsigned int)workers.size(); }
+	int getQueuedTasks() const { return queuedTasks.load(); }		// Tasks waiting to be executed, a hint for splitting work
+
+private:
+
+	void workerLoop(int index);
+	bool runTask(int index);		// Runs one task, taken from queue index (if any) or stolen from the others
+
+};